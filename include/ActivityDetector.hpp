@@ -0,0 +1,194 @@
+/********************************************************************
+* libavio/include/ActivityDetector.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef ACTIVITYDETECTOR_HPP
+#define ACTIVITYDETECTOR_HPP
+
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <functional>
+#include <algorithm>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/motion_vector.h>
+}
+
+namespace avio {
+
+// One reading of the detector
+struct Activity {
+    int64_t time = 0;                   // stream time in milliseconds
+    float score = 0;                    // inter frame bit rate over the baseline, 0.5 is half again as much
+    float bitrate = 0;                  // kbit/s of the inter frames over the window
+    float baseline = 0;                 // kbit/s
+    float motion = -1;                  // share of the picture in motion, -1 without motion vectors
+    bool active = false;
+};
+
+// Judges activity in a video stream from the compressed packets alone, so a camera with nothing going on
+// needs no decoding at all. A still scene costs the encoder very little between key frames and movement
+// costs it more, so the bit rate of the inter frames over a short window is compared with a slowly moving
+// baseline. Key frames are left out, their size follows the GOP cadence rather than the scene.
+//
+// When the stream is being decoded anyway, the decoder can also export its motion vectors, and the share
+// of the picture covered by blocks that moved more than a couple of pixels is a second, sharper signal.
+// Either one going over its threshold makes the stream active, it stays active until both have been
+// quiet for the hold time.
+
+class ActivityDetector {
+public:
+    std::string uri;
+    AVRational time_base;
+    int64_t start_pts = 0;
+
+    int window_ms = 1000;
+    int interval_ms = 500;              // how often a reading is made
+    int baseline_seconds = 60;
+    float active_learning = 0.25f;      // share of the learning rate kept while active
+    int warmup_ms = 5000;               // the baseline settles before anything is reported active
+    float threshold = 0.5f;
+    bool motion_vectors = false;        // ask the decoder for motion vectors
+    float motion_threshold = 0.02f;
+    int motion_min_px = 2;
+    int hold_ms = 5000;
+
+    std::function<void(const Activity& activity, const std::string& uri)> activityCallback = nullptr;
+    std::function<void(bool active)> trigger = nullptr;
+
+    std::deque<std::pair<int64_t, int>> window;
+    int64_t window_bytes = 0;
+    double baseline = 0;
+    int64_t first_time = -1;
+    int64_t last_time = -1;
+    int64_t last_reading = -1;
+    int64_t last_over = -1;
+    int64_t readings = 0;
+    float motion = -1;
+    int64_t motion_time = -1;
+    Activity last;
+    std::mutex mutex;
+
+    ActivityDetector(const std::string& uri, AVStream* stream) : uri(uri) {
+        time_base = stream->time_base;
+        start_pts = stream->start_time == AV_NOPTS_VALUE ? 0 : stream->start_time;
+    }
+
+    // every demuxed video packet, on the reader thread
+    void packet(const AVPacket* pkt) {
+        if (pkt->pts == AV_NOPTS_VALUE)
+            return;
+        int64_t time = (int64_t)(1000 * av_q2d(time_base) * (pkt->pts - start_pts));
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (last_time >= 0 && (time < last_time || time - last_time > 10000)) {
+            // the stream has jumped, the window no longer describes the scene
+            window.clear();
+            window_bytes = 0;
+            last_reading = -1;
+        }
+        last_time = time;
+        if (first_time < 0)
+            first_time = time;
+
+        if (!(pkt->flags & AV_PKT_FLAG_KEY)) {
+            window.emplace_back(time, pkt->size);
+            window_bytes += pkt->size;
+        }
+        while (window.size() && window.front().first <= time - window_ms) {
+            window_bytes -= window.front().second;
+            window.pop_front();
+        }
+
+        if (last_reading >= 0 && time - last_reading < interval_ms)
+            return;
+        last_reading = time;
+        Activity activity = reading(time);
+        bool changed = activity.active != last.active;
+        last = activity;
+        lock.unlock();
+
+        if (changed && trigger)
+            trigger(activity.active);
+        if (activityCallback)
+            activityCallback(activity, uri);
+    }
+
+    Activity reading(int64_t time) {
+        Activity activity;
+        activity.time = time;
+        activity.bitrate = (float)(window_bytes * 8.0 / window_ms);
+
+        bool warm = time - first_time >= warmup_ms;
+        readings++;
+        if (!warm)
+            baseline += (activity.bitrate - baseline) / readings;
+        else
+            // An event should not become normal while it lasts, so the baseline learns more slowly while
+            // active. It still learns, a lasting change such as lights or rain ends up in the baseline.
+            baseline += (activity.bitrate - baseline) * interval_ms / (baseline_seconds * 1000.0) * (last.active ? active_learning : 1.0);
+        activity.baseline = (float)baseline;
+        activity.score = baseline > 1 ? std::max(0.0f, (float)(activity.bitrate / baseline) - 1) : 0;
+
+        // motion vectors older than the window are from a decoder that has stopped
+        bool recent = motion_time >= 0 && time - motion_time <= window_ms;
+        activity.motion = recent ? motion : -1;
+
+        bool over = warm && (activity.score >= threshold || (recent && motion >= motion_threshold));
+        if (over)
+            last_over = time;
+        activity.active = over || (last.active && time - last_over < hold_ms);
+        return activity;
+    }
+
+    // decoded video frames when motion vectors are enabled, on the decoder thread
+    void frame(const AVFrame* frame) {
+        AVFrameSideData* sd = av_frame_get_side_data(frame, AV_FRAME_DATA_MOTION_VECTORS);
+        if (!sd || frame->width <= 0 || frame->height <= 0)
+            return;
+        const AVMotionVector* mvs = (const AVMotionVector*)sd->data;
+        size_t count = sd->size / sizeof(AVMotionVector);
+        int64_t moving = 0;
+        int64_t min_sq = (int64_t)motion_min_px * motion_min_px;
+        for (size_t i = 0; i < count; i++) {
+            int64_t dx = mvs[i].dst_x - mvs[i].src_x;
+            int64_t dy = mvs[i].dst_y - mvs[i].src_y;
+            if (dx * dx + dy * dy >= min_sq)
+                moving += (int64_t)mvs[i].w * mvs[i].h;
+        }
+        float share = std::min(1.0f, (float)moving / ((float)frame->width * frame->height));
+        int64_t time = frame->pts == AV_NOPTS_VALUE ? -1 : (int64_t)(1000 * av_q2d(time_base) * (frame->pts - start_pts));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        motion = share;
+        motion_time = time >= 0 ? time : last_time;
+    }
+
+    Activity current() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return last;
+    }
+};
+
+}
+
+#endif // ACTIVITYDETECTOR_HPP
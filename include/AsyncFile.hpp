@@ -0,0 +1,316 @@
+/********************************************************************
+* libavio/include/AsyncFile.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef ASYNCFILE_HPP
+#define ASYNCFILE_HPP
+
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <map>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavformat/avio.h>
+}
+
+#include "Compatability.hpp"
+#include "Exception.hpp"
+#include "Queue.hpp"
+
+namespace avio {
+
+#define IO_BUFFER_SIZE 65536
+#define IO_BLOCK_ALIGNMENT 4096
+
+// counters shared by all the files opened by one writer, updated from both the writer and the disk thread
+struct IOStats {
+    std::atomic<int64_t> bytes_written { 0 };
+    std::atomic<int64_t> blocks_written { 0 };
+    std::atomic<int64_t> queued_bytes { 0 };
+    std::atomic<int64_t> peak_queued_bytes { 0 };
+    std::atomic<int64_t> stalls { 0 };
+    std::atomic<int64_t> stall_ms { 0 };
+    std::atomic<int64_t> errors { 0 };
+
+    std::map<std::string, int64_t> to_map() const {
+        return {
+            { "bytes_written",     bytes_written },
+            { "blocks_written",    blocks_written },
+            { "queued_bytes",      queued_bytes },
+            { "peak_queued_bytes", peak_queued_bytes },
+            { "stalls",            stalls },
+            { "stall_ms",          stall_ms },
+            { "errors",            errors }
+        };
+    }
+};
+
+class AsyncFile;
+
+struct Block {
+    AsyncFile* file = nullptr;
+    uint8_t* data = nullptr;
+    int64_t offset = 0;
+    size_t size = 0;
+};
+
+// A single disk thread serves every open AsyncFile. Blocks are written strictly in the order they were
+// submitted, so a muxer seeking back to patch a header is always written after the data it overwrites.
+
+class DiskThread {
+public:
+    Queue<Block> blocks;
+    std::thread* thread = nullptr;
+
+    static DiskThread* instance() {
+        // intentionally never deleted, the thread lives for the duration of the process
+        static DiskThread* disk_thread = new DiskThread();
+        return disk_thread;
+    }
+
+    void submit(Block&& block) {
+        blocks.push(std::move(block));
+    }
+
+private:
+    DiskThread() {
+        thread = new std::thread([&] { while (true) service(blocks.pop()); });
+        thread->detach();
+    }
+
+    void service(Block&& block);
+};
+
+class AsyncFile {
+public:
+    std::string filename;
+    FILE* fp = nullptr;
+    AVIOContext* pb = nullptr;
+    IOStats* stats = nullptr;
+    size_t block_size;
+    int max_blocks;
+
+    uint8_t* block = nullptr;
+    int64_t block_offset = 0;
+    size_t block_fill = 0;
+    int64_t position = 0;
+    int64_t file_size = 0;
+    int64_t disk_position = 0;          // only touched by the disk thread
+
+    int in_flight = 0;
+    std::vector<uint8_t*> free_blocks;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool failed = false;
+    ExceptionChecker ex;
+
+    AsyncFile(const std::string& filename, IOStats* stats, size_t block_size = 1 << 20, int max_blocks = 16)
+            : filename(filename), stats(stats), block_size(block_size), max_blocks(max_blocks) {
+        if (!(fp = fopen(filename.c_str(), "wb"))) {
+            std::stringstream str;
+            str << "unable to open " << filename << " for writing";
+            throw std::runtime_error(str.str());
+        }
+        // the blocks are already large, stdio buffering would only add another copy
+        setvbuf(fp, nullptr, _IONBF, 0);
+
+        unsigned char* buffer = nullptr;
+        ex.ck((buffer = (unsigned char*)av_malloc(IO_BUFFER_SIZE)), AM);
+        pb = avio_alloc_context(buffer, IO_BUFFER_SIZE, 1, this, nullptr, write_packet, seek);
+        if (!pb) {
+            av_free(buffer);
+            fclose(fp);
+            throw std::runtime_error("avio_alloc_context has failed with NULL value");
+        }
+        pb->seekable = 1;
+    }
+
+    ~AsyncFile() {
+        close();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (block) free_aligned(block);
+        for (uint8_t* b : free_blocks) free_aligned(b);
+    }
+
+    static int write_packet(void* opaque, AVIO_WRITE_CONST uint8_t* buf, int buf_size) {
+        return ((AsyncFile*)opaque)->write(buf, buf_size);
+    }
+
+    static int64_t seek(void* opaque, int64_t offset, int whence) {
+        return ((AsyncFile*)opaque)->seek(offset, whence);
+    }
+
+    int write(const uint8_t* buf, int buf_size) {
+        if (failed) return AVERROR(EIO);
+        if (block && position != block_offset + (int64_t)block_fill)
+            submit();
+        int remaining = buf_size;
+        while (remaining > 0) {
+            if (!block) {
+                block = get_block();
+                block_offset = position;
+                block_fill = 0;
+            }
+            size_t n = std::min(block_size - block_fill, (size_t)remaining);
+            memcpy(block + block_fill, buf, n);
+            block_fill += n;
+            buf += n;
+            remaining -= n;
+            position += n;
+            if (block_fill == block_size)
+                submit();
+        }
+        if (position > file_size) file_size = position;
+        return buf_size;
+    }
+
+    int64_t seek(int64_t offset, int whence) {
+        if (whence & AVSEEK_SIZE)
+            return file_size;
+        switch (whence & ~AVSEEK_FORCE) {
+            case SEEK_SET:
+                position = offset;
+                break;
+            case SEEK_CUR:
+                position += offset;
+                break;
+            case SEEK_END:
+                position = file_size + offset;
+                break;
+            default:
+                return AVERROR(EINVAL);
+        }
+        return position;
+    }
+
+    void submit() {
+        if (!block) return;
+        if (!block_fill) return;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (in_flight >= max_blocks) {
+                // the disk has fallen behind, hold the writer back rather than buffer without limit
+                stats->stalls++;
+                auto start = std::chrono::steady_clock::now();
+                cv.wait(lock, [&] { return in_flight < max_blocks; });
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                stats->stall_ms += std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+            }
+            in_flight++;
+        }
+        int64_t queued = (stats->queued_bytes += block_fill);
+        int64_t peak = stats->peak_queued_bytes;
+        while (queued > peak && !stats->peak_queued_bytes.compare_exchange_weak(peak, queued)) {}
+
+        Block b;
+        b.file = this;
+        b.data = block;
+        b.offset = block_offset;
+        b.size = block_fill;
+        block = nullptr;
+        block_fill = 0;
+        DiskThread::instance()->submit(std::move(b));
+    }
+
+    void complete(Block& b, bool ok) {
+        stats->queued_bytes -= b.size;
+        if (ok) {
+            stats->bytes_written += b.size;
+            stats->blocks_written++;
+        }
+        else {
+            stats->errors++;
+        }
+        // notify while still holding the lock, once it is released close() may return and the file be deleted
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!ok) failed = true;
+        free_blocks.push_back(b.data);
+        in_flight--;
+        cv.notify_all();
+    }
+
+    void close() {
+        if (!fp) return;
+        if (pb) avio_flush(pb);
+        submit();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return in_flight == 0; });
+        }
+        if (fclose(fp)) stats->errors++;
+        fp = nullptr;
+        if (pb) {
+            av_freep(&pb->buffer);
+            avio_context_free(&pb);
+        }
+        if (failed) std::cout << "disk write error on " << filename << std::endl;
+    }
+
+    uint8_t* get_block() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (free_blocks.size()) {
+                uint8_t* b = free_blocks.back();
+                free_blocks.pop_back();
+                return b;
+            }
+        }
+        uint8_t* b = nullptr;
+#ifdef _WIN32
+        b = (uint8_t*)_aligned_malloc(block_size, IO_BLOCK_ALIGNMENT);
+#else
+        if (posix_memalign((void**)&b, IO_BLOCK_ALIGNMENT, block_size)) b = nullptr;
+#endif
+        if (!b) throw std::runtime_error("disk block allocation failure");
+        return b;
+    }
+
+    static void free_aligned(uint8_t* b) {
+#ifdef _WIN32
+        _aligned_free(b);
+#else
+        free(b);
+#endif
+    }
+};
+
+inline void DiskThread::service(Block&& block) {
+    AsyncFile* file = block.file;
+    bool ok = true;
+    if (file->disk_position != block.offset) {
+#ifdef _WIN32
+        ok = !_fseeki64(file->fp, block.offset, SEEK_SET);
+#else
+        ok = !fseeko(file->fp, block.offset, SEEK_SET);
+#endif
+    }
+    if (ok) ok = (fwrite(block.data, 1, block.size, file->fp) == block.size);
+    file->disk_position = ok ? block.offset + block.size : -1;
+    file->complete(block, ok);
+}
+
+}
+
+#endif // ASYNCFILE_HPP
@@ -22,6 +22,9 @@
 
 #include <SDL.h>
 #include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 
 extern "C" {
 #include <libswresample/swresample.h>
@@ -31,29 +34,33 @@ extern "C" {
 #include "Queue.hpp"
 #include "Reader.hpp"
 #include "Exception.hpp"
+#include "AudioRing.hpp"
+#include "Mixer.hpp"
+#include "AudioAnalyzer.hpp"
 
 namespace avio {
 
-class Audio {
+class Audio : public AudioSource {
 public:
     SDL_AudioSpec sdl = { 0 };
     SDL_AudioSpec have = { 0 };
     SDL_AudioDeviceID device_id = -1;
-    Reader* reader = nullptr;
+    Mixer* mixer = nullptr;             // when set the stream is played through the shared device
     Queue<Frame>* frames = nullptr;
+    AudioAnalyzer* analyzer = nullptr;  // levels are measured on the feeder when set
     ExceptionChecker ex;
     SwrContext* swr_ctx = nullptr;
     AVSampleFormat output_format = AV_SAMPLE_FMT_S16;
 
-    uint8_t* buffer = nullptr;
+    // resampled audio waits in the ring for the callback, which only copies it out
+    std::thread* feeder = nullptr;
+    uint8_t* buffer = nullptr;          // used by the feeder thread only
     int size = 0;
-    uint8_t* temp = nullptr;
+    uint8_t* temp = nullptr;            // used by the callback only, allocated before the device starts
     int temp_size = 0;
-    int residual = 0;
+    int bytes_per_second = 0;
 
-    float volume = 1.0f;
-    bool mute = false;
-    bool closed = false;
+    std::atomic<bool> stopping { false };
     int audio_driver_index = 0; 
 
     
@@ -61,108 +68,158 @@ public:
     std::function<void(float progress, const std::string& uri)> progressCallback = nullptr;
     int last_progress = 0;
 
-    Audio(Reader* reader, Queue<Frame>* frames, int audio_driver_index);
+    Audio(Reader* reader, Queue<Frame>* frames, int audio_driver_index, bool mixed = false);
     ~Audio();
+    int feed();
+    bool write(const uint8_t* data, int length, int64_t end_rts);
+    int ring_size(int device_bytes) const;
     int get_number_of_samples(AVCodecParameters* codecpar);
     void update_progress(int64_t pts);
     void error(const std::string& msg);
 };
 
+// Runs on the SDL audio thread, nothing here may block, allocate or call into python
 void callback(void* user_data, uint8_t* output_buffer, int output_length) {
     Audio* audio = (Audio*)user_data;
     memset(output_buffer, 0, output_length);
-    int avail = output_length;
 
     if (audio->reader->terminated) {
-        audio->frames->clear();
         audio->closed = true;
         SDL_PauseAudioDevice(audio->device_id, 1);
         return;
     }
 
+    if (audio->flush) {
+        audio->ring->discard();
+        audio->flush = false;
+    }
+
     if (audio->reader->paused) 
         return;
 
+    int offset = 0;
+    int peak = 0;
+    while (offset < output_length) {
+        int length = std::min(output_length - offset, audio->temp_size);
+        int n = (int)audio->ring->read(audio->temp, length);
+        if (n > 0 && !audio->mute)
+            SDL_MixAudioFormat(output_buffer + offset, audio->temp, audio->sdl.format, n, SDL_MIX_MAXVOLUME * audio->volume);
+        peak = std::max(peak, peak_s16((const int16_t*)audio->temp, n / sizeof(int16_t)));
+        audio->peak = peak / 32767.0f;
+        offset += n;
+        if (n < length) {
+            // an empty ring after the last frame means the stream has played out
+            if (audio->draining) audio->closed = true;
+            break;
+        }
+    }
+}
+
+// Runs on the feeder thread, converts decoded frames and queues the samples for the callback
+int Audio::feed() {
+    if (stopping || reader->terminated) {
+        frames->clear();
+        return 0;
+    }
+
+    if (reader->paused) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return 1;
+    }
+
+    if (reader->live_stream && !reader->is_timeshifting() && reader->audio_pkts)
+        reader->audio_pkts->remove_latency();
+
+    Frame f = frames->pop();
+
+    if (f.is_null() || reader->terminated || stopping) {
+        draining = true;
+        return 0;
+    }
+
+    if (reader->seek_pts != AV_NOPTS_VALUE) {
+        flush = true;
+        return 1;
+    }
+
     try {
-        if (audio->temp_size != output_length) {
-            if (audio->temp) free(audio->temp);
-            audio->ex.ck(audio->temp = (uint8_t*)malloc(output_length));
-            audio->temp_size = output_length;
+        int64_t rts = reader->real_time(reader->audio_stream_index, f.pts());
+        if (reader->is_timeshifting() && rts < reader->timeshift->resume_time)
+            return 1;
+
+        int max_samples = swr_get_out_samples(swr_ctx, f.samples());
+        if (max_samples <= 0)
+            return 1;
+        int output_size = av_samples_get_buffer_size(NULL, have.channels, max_samples, output_format, 0);
+        if (size < output_size) {
+            if (buffer) free(buffer);
+            ex.ck(buffer = (uint8_t*)malloc(output_size));
+            size = output_size;
+        }
+        const uint8_t** data = (const uint8_t**)&f.frame->data[0];
+        int samples = 0;
+        ex.ck(samples = swr_convert(swr_ctx, &buffer, max_samples, data, f.samples()), SC);
+        int length = av_samples_get_buffer_size(NULL, have.channels, samples, output_format, 1);
+        int64_t end_rts = rts + (int64_t)samples * 1000 / have.freq;
+        if (!write(buffer, length, end_rts))
+            return 0;
+
+        if (analyzer) {
+            analyzer->process(f);
         }
-        memset(audio->temp, 0, output_length);
-
-        while (avail > 0 && !audio->closed) {
-            if (!audio->residual) {
-
-                if (audio->reader->live_stream)
-                    audio->reader->audio_pkts->remove_latency();
-
-                Frame f = audio->frames->pop();
-
-                if (f.is_null() || audio->reader->terminated) {
-                    audio->closed = true;
-                    return;
-                }
-                else {
-                    if (audio->reader->seek_pts != AV_NOPTS_VALUE) {
-                        return;
-                    }
-                    
-                    int64_t rts = audio->reader->real_time(audio->reader->audio_stream_index, f.pts());
-                    audio->reader->update_rt(audio->reader->audio_stream_index, rts);
-                    int input_size = av_samples_get_buffer_size(NULL, f.channels(), f.samples(), audio->output_format, 0);
-                    if (audio->size != input_size) {
-                        if (audio->buffer) free(audio->buffer);
-                        audio->ex.ck(audio->buffer = (uint8_t*)malloc(input_size));
-                        audio->size = input_size;
-                    }
-                    const uint8_t** data = (const uint8_t**)&f.frame->data[0];
-                    audio->ex.ck(swr_convert(audio->swr_ctx, &audio->buffer, audio->have.samples, data, f.samples()), SC);
-
-                    int to_write = 0;
-                    if (audio->size > avail) {
-                        to_write = avail;
-                        audio->residual = avail;
-                    }
-                    else {
-                        to_write = audio->size;
-                    }
-
-                    int accum = output_length - avail;
-                    memcpy(audio->temp + accum, audio->buffer, to_write);
-                    avail -= to_write;
-                }
-
-                if (audio->pyAudioCallback) {
-                    audio->pyAudioCallback(f, audio->reader->uri);
-                }
-                if (audio->progressCallback) {
-                    audio->update_progress(f.pts());
-                }
 
-            }
-            else {
-                int data_size = audio->size - audio->residual; 
-                int length = (data_size > output_length) ? output_length : data_size;
-                memcpy(audio->temp, audio->buffer + audio->residual, length);
-                avail -= length;
-                audio->residual -= (audio->size - length);
-            }
+        if (pyAudioCallback) {
+            pyAudioCallback(f, reader->uri);
         }
-        if (!audio->mute) {
-            SDL_MixAudioFormat(output_buffer, audio->temp, audio->sdl.format, output_length, SDL_MIX_MAXVOLUME * audio->volume);
+        if (progressCallback) {
+            update_progress(f.pts());
         }
     }
     catch (const std::exception& e) {
-        std::cout << "audio callback error: " << e.what() << std::endl;
+        std::cout << "audio feeder error: " << e.what() << std::endl;
+    }
+    return 1;
+}
+
+// Waits for room in the ring as the callback drains it. The clock that video is synchronized against is
+// the time of the sample being heard, which trails the end of the last frame by whatever is still queued.
+bool Audio::write(const uint8_t* data, int length, int64_t end_rts) {
+    int written = 0;
+    while (true) {
+        written += (int)ring->write(data + written, length - written);
+        int64_t queued = (int64_t)ring->available() * 1000 / bytes_per_second;
+        reader->update_rt(reader->audio_stream_index, end_rts - (int64_t)(length - written) * 1000 / bytes_per_second - queued);
+        if (written >= length)
+            return true;
+        if (stopping || reader->terminated || closed)
+            return false;
+        if (flush || reader->seek_pts != AV_NOPTS_VALUE)
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
     }
 }
 
-Audio::Audio(Reader* reader, Queue<Frame>* frames, int audio_driver_index) : reader(reader), frames(frames), audio_driver_index(audio_driver_index) {
+Audio::Audio(Reader* reader, Queue<Frame>* frames, int audio_driver_index, bool mixed) 
+        : AudioSource(reader), frames(frames), audio_driver_index(audio_driver_index) {
     AVCodecParameters* codecpar = reader->fmt_ctx->streams[reader->audio_stream_index]->codecpar;
     ex.ck(swr_ctx = swr_alloc());
+
+    if (mixed) {
+        // the stream is converted to the format of the shared device and handed to the mixer
+        mixer = Mixer::instance();
+        mixer->open(audio_driver_index);
+        have = mixer->have;
+        sdl = mixer->sdl;
+        ex.ck(swr_alloc_set_opts_compat(&swr_ctx, codecpar, output_format, have.freq, have.channels), SASO);
+        ex.ck(swr_init(swr_ctx), SI);
+        int frame_bytes = have.channels * av_get_bytes_per_sample(output_format);
+        bytes_per_second = have.freq * frame_bytes;
+        ring = new AudioRing(ring_size(have.size), frame_bytes);
+        feeder = new std::thread([&] { while (feed()) {} });
+        mixer->add(this);
+        return;
+    }
     
-    ex.ck(swr_ctx = swr_alloc());
     ex.ck(swr_alloc_set_opts_compat(&swr_ctx, codecpar, output_format, codecpar->sample_rate), SASO);
     ex.ck(swr_init(swr_ctx), SI);
 
@@ -189,17 +246,44 @@ Audio::Audio(Reader* reader, Queue<Frame>* frames, int audio_driver_index) : rea
     if (!(device_id = SDL_OpenAudioDevice(NULL, 0, &sdl, &have, 0)))
         error("SDL_OpenAudioDevice error");
 
+    int frame_bytes = have.channels * av_get_bytes_per_sample(output_format);
+    bytes_per_second = have.freq * frame_bytes;
+    temp_size = std::max((int)have.size, have.samples * frame_bytes);
+    ex.ck(temp = (uint8_t*)malloc(temp_size));
+    ring = new AudioRing(ring_size(temp_size), frame_bytes);
+
+    feeder = new std::thread([&] { while (feed()) {} });
+
     SDL_PauseAudioDevice(device_id, 0);
 }
 
 Audio::~Audio() {
-    if (SDL_WasInit(SDL_INIT_AUDIO) && device_id > 0)
+    if (mixer)
+        mixer->remove(this);
+    else if (SDL_WasInit(SDL_INIT_AUDIO) && device_id > 0)
         SDL_CloseAudioDevice(device_id);
+    if (feeder) {
+        // the pipeline threads are gone by now, a null frame releases a feeder waiting on an empty queue
+        stopping = true;
+        frames->clear();
+        frames->push(Frame(nullptr));
+        feeder->join();
+        delete feeder;
+    }
+    if (ring) delete ring;
     if (swr_ctx) swr_free(&swr_ctx);
     if (buffer) free(buffer);
     if (temp) free(temp);
 }
 
+// Room for a few device buffers, enough to ride out a busy pipeline. Under a latency target the ring holds
+// no more than half of it, the device buffer itself is the floor.
+int Audio::ring_size(int device_bytes) const {
+    if (reader->latency_target > 0)
+        return std::max(2 * device_bytes, (int)(bytes_per_second * reader->latency_target / 2000));
+    return std::max(4 * device_bytes, bytes_per_second / 5);
+}
+
 int Audio::get_number_of_samples(AVCodecParameters* codecpar) {
     int samples = codecpar->frame_size;
     if ( !samples && 
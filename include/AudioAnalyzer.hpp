@@ -0,0 +1,327 @@
+/********************************************************************
+* libavio/include/AudioAnalyzer.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef AUDIOANALYZER_HPP
+#define AUDIOANALYZER_HPP
+
+#include <cmath>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <algorithm>
+
+extern "C" {
+#include <libswresample/swresample.h>
+}
+
+#include "Frame.hpp"
+#include "Queue.hpp"
+#include "Reader.hpp"
+#include "Exception.hpp"
+#include "Mixer.hpp"
+
+namespace avio {
+
+// Levels of one analysis window, all in dB relative to full scale
+struct AudioLevel {
+    int64_t time = 0;                   // stream time of the start of the window in milliseconds
+    int64_t duration = 0;               // milliseconds
+    float rms = 0;
+    float peak = 0;
+    float loudness = 0;                 // momentary loudness over the last 400 ms in LUFS, when enabled
+    bool silent = false;                // the level has stayed below the silence threshold long enough
+    int64_t silence = 0;                // milliseconds the level has been below the threshold
+};
+
+// the kernels share the instruction set selection of the mixer
+
+inline float sum_squares_f32(const float* src, int n) {
+    int i = 0;
+    float sum = 0;
+#if defined(AVIO_MIX_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(src + i);
+        acc = _mm_add_ps(acc, _mm_mul_ps(x, x));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(AVIO_MIX_NEON)
+    float32x4_t acc = vdupq_n_f32(0);
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t x = vld1q_f32(src + i);
+        acc = vmlaq_f32(acc, x, x);
+    }
+    sum = vaddvq_f32(acc);
+#endif
+    for (; i < n; i++)
+        sum += src[i] * src[i];
+    return sum;
+}
+
+inline float peak_f32(const float* src, int n) {
+    int i = 0;
+    float peak = 0;
+#if defined(AVIO_MIX_SSE2)
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 vpeak = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4)
+        vpeak = _mm_max_ps(vpeak, _mm_andnot_ps(sign, _mm_loadu_ps(src + i)));
+    float lanes[4];
+    _mm_storeu_ps(lanes, vpeak);
+    peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#elif defined(AVIO_MIX_NEON)
+    float32x4_t vpeak = vdupq_n_f32(0);
+    for (; i + 4 <= n; i += 4)
+        vpeak = vmaxq_f32(vpeak, vabsq_f32(vld1q_f32(src + i)));
+    peak = vmaxvq_f32(vpeak);
+#endif
+    for (; i < n; i++)
+        peak = std::max(peak, std::fabs(src[i]));
+    return peak;
+}
+
+// Second order section in transposed direct form, one per channel and stage of the K weighting filter
+struct Biquad {
+    double b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+    double z1 = 0, z2 = 0;
+
+    void run(const float* src, float* dst, int n) {
+        for (int i = 0; i < n; i++) {
+            double x = src[i];
+            double y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            dst[i] = (float)y;
+        }
+    }
+};
+
+// Computes levels natively instead of handing every frame to python. Decoded audio is converted to planar
+// float and summarized per window, the caller only hears about the windows. The analyzer either runs on
+// the audio feeder alongside playback, or on its own thread as the only consumer of the filtered frames,
+// in which case no audio device is opened and files are analyzed as fast as they decode.
+
+class AudioAnalyzer {
+public:
+    Reader* reader = nullptr;
+    Queue<Frame>* frames = nullptr;
+    SwrContext* swr_ctx = nullptr;
+    ExceptionChecker ex;
+    int channels = 0;
+    int sample_rate = 0;
+
+    int window_ms = 100;
+    float silence_threshold = -50.0f;   // dBFS
+    int silence_min_ms = 2000;
+    bool loudness = false;
+    std::function<void(const AudioLevel& level, const std::string& uri)> audioLevelCallback = nullptr;
+
+    std::vector<std::vector<float>> planes;
+    std::vector<uint8_t*> pointers;
+    std::vector<float> weighted;
+    std::vector<Biquad> shelf;
+    std::vector<Biquad> highpass;
+
+    // current window
+    int window_samples = 0;
+    int count = 0;
+    int64_t window_time = -1;
+    double sum = 0;
+    float peak = 0;
+    std::vector<double> k_sum;
+    std::deque<double> blocks;          // K weighted power of the windows making up the loudness interval
+    int64_t silence = 0;
+
+    AudioLevel last;
+
+    AudioAnalyzer(Reader* reader, Queue<Frame>* frames = nullptr) : reader(reader), frames(frames) {
+        AVCodecParameters* codecpar = reader->fmt_ctx->streams[reader->audio_stream_index]->codecpar;
+        channels = std::max(1, channel_count_from_codecpar(codecpar));
+        sample_rate = codecpar->sample_rate;
+        ex.ck(swr_ctx = swr_alloc());
+        ex.ck(swr_alloc_set_opts_compat(&swr_ctx, codecpar, AV_SAMPLE_FMT_FLTP, sample_rate, channels), SASO);
+        ex.ck(swr_init(swr_ctx), SI);
+        planes.resize(channels);
+        pointers.resize(channels);
+        k_sum.resize(channels);
+        init_k_weighting();
+    }
+
+    ~AudioAnalyzer() {
+        if (swr_ctx) swr_free(&swr_ctx);
+    }
+
+    // standalone mode, runs until the end of the stream
+    int run() {
+        Frame f = frames->pop();
+        if (f.is_null() || reader->terminated)
+            return 0;
+        if (reader->seek_pts != AV_NOPTS_VALUE) {
+            reset();
+            return 1;
+        }
+        try {
+            process(f);
+        }
+        catch (const std::exception& e) {
+            std::cout << "audio analyzer error: " << e.what() << std::endl;
+        }
+        return 1;
+    }
+
+    void process(const Frame& f) {
+        int max_samples = swr_get_out_samples(swr_ctx, f.samples());
+        if (max_samples <= 0)
+            return;
+        for (int ch = 0; ch < channels; ch++) {
+            if ((int)planes[ch].size() < max_samples) planes[ch].resize(max_samples);
+            pointers[ch] = (uint8_t*)planes[ch].data();
+        }
+        if ((int)weighted.size() < max_samples) weighted.resize(max_samples);
+
+        int samples = 0;
+        ex.ck(samples = swr_convert(swr_ctx, pointers.data(), max_samples, (const uint8_t**)f.frame->data, f.samples()), SC);
+
+        if (!window_samples)
+            window_samples = std::max(1, (int)((int64_t)sample_rate * window_ms / 1000));
+        int64_t rts = reader->real_time(reader->audio_stream_index, f.pts());
+
+        int offset = 0;
+        while (offset < samples) {
+            if (!count)
+                window_time = rts < 0 ? -1 : rts + (int64_t)offset * 1000 / sample_rate;
+            int n = std::min(samples - offset, window_samples - count);
+            for (int ch = 0; ch < channels; ch++) {
+                const float* src = planes[ch].data() + offset;
+                sum += sum_squares_f32(src, n);
+                peak = std::max(peak, peak_f32(src, n));
+                if (loudness) {
+                    shelf[ch].run(src, weighted.data(), n);
+                    highpass[ch].run(weighted.data(), weighted.data(), n);
+                    k_sum[ch] += sum_squares_f32(weighted.data(), n);
+                }
+            }
+            count += n;
+            offset += n;
+            if (count == window_samples)
+                emit();
+        }
+    }
+
+    void emit() {
+        AudioLevel level;
+        level.time = window_time;
+        level.duration = (int64_t)count * 1000 / sample_rate;
+        level.rms = decibels(sum / ((double)count * channels));
+        level.peak = decibels((double)peak * peak);
+
+        if (level.rms < silence_threshold)
+            silence += level.duration;
+        else
+            silence = 0;
+        level.silence = silence;
+        level.silent = silence >= silence_min_ms;
+
+        if (loudness) {
+            double power = 0;
+            for (int ch = 0; ch < channels; ch++) {
+                power += weight(ch) * k_sum[ch] / count;
+                k_sum[ch] = 0;
+            }
+            blocks.push_back(power);
+            size_t span = std::max(1, 400 / std::max(1, window_ms));
+            while (blocks.size() > span)
+                blocks.pop_front();
+            double mean = 0;
+            for (double block : blocks) mean += block;
+            mean /= blocks.size();
+            level.loudness = mean > 0 ? std::max(-120.0, -0.691 + 10 * log10(mean)) : -120.0f;
+        }
+
+        count = 0;
+        sum = 0;
+        peak = 0;
+        last = level;
+        if (audioLevelCallback)
+            audioLevelCallback(level, reader->uri);
+    }
+
+    // the timeline has jumped, the partial window and filter history no longer apply
+    void reset() {
+        count = 0;
+        sum = 0;
+        peak = 0;
+        silence = 0;
+        blocks.clear();
+        std::fill(k_sum.begin(), k_sum.end(), 0);
+        for (Biquad& b : shelf)    b.z1 = b.z2 = 0;
+        for (Biquad& b : highpass) b.z1 = b.z2 = 0;
+    }
+
+    static float decibels(double power) {
+        return power > 1e-12 ? (float)(10 * log10(power)) : -120.0f;
+    }
+
+    // ITU-R BS.1770 channel weights, surround channels of a 5.1 layout count more and LFE is left out
+    double weight(int ch) const {
+        if (channels == 6) {
+            if (ch == 3) return 0.0;
+            if (ch > 3)  return 1.41;
+        }
+        return 1.0;
+    }
+
+    // ITU-R BS.1770 pre filter and RLB high pass, derived for the stream sample rate
+    void init_k_weighting() {
+        const double pi = 3.14159265358979323846;
+        Biquad s;
+        double f0 = 1681.974450955533;
+        double G  = 3.999843853973347;
+        double Q  = 0.7071752369554196;
+        double K  = tan(pi * f0 / sample_rate);
+        double Vh = pow(10.0, G / 20.0);
+        double Vb = pow(Vh, 0.4996667741545416);
+        double a0 = 1.0 + K / Q + K * K;
+        s.b0 = (Vh + Vb * K / Q + K * K) / a0;
+        s.b1 = 2.0 * (K * K - Vh) / a0;
+        s.b2 = (Vh - Vb * K / Q + K * K) / a0;
+        s.a1 = 2.0 * (K * K - 1.0) / a0;
+        s.a2 = (1.0 - K / Q + K * K) / a0;
+
+        Biquad h;
+        f0 = 38.13547087602444;
+        Q  = 0.5003270373238773;
+        K  = tan(pi * f0 / sample_rate);
+        a0 = 1.0 + K / Q + K * K;
+        h.b0 = 1.0;
+        h.b1 = -2.0;
+        h.b2 = 1.0;
+        h.a1 = 2.0 * (K * K - 1.0) / a0;
+        h.a2 = (1.0 - K / Q + K * K) / a0;
+
+        shelf.assign(channels, s);
+        highpass.assign(channels, h);
+    }
+};
+
+}
+
+#endif // AUDIOANALYZER_HPP
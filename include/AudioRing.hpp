@@ -0,0 +1,91 @@
+/********************************************************************
+* libavio/include/AudioRing.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef AUDIORING_HPP
+#define AUDIORING_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+namespace avio {
+
+// Single producer, single consumer ring of PCM bytes. The producer is a normal thread that resamples
+// decoded frames, the consumer is the real time audio callback, which must never block or allocate,
+// so the two sides only share a pair of monotonic counters. Transfers are whole sample frames of
+// align bytes so that a short read never splits the channels of a sample.
+
+class AudioRing {
+public:
+    std::vector<uint8_t> data;
+    size_t capacity;
+    size_t align;
+    std::atomic<uint64_t> head { 0 };   // bytes read, owned by the consumer
+    std::atomic<uint64_t> tail { 0 };   // bytes written, owned by the producer
+
+    AudioRing(size_t size, size_t align) : align(align ? align : 1) {
+        capacity = std::max(size - size % this->align, this->align);
+        data.resize(capacity);
+    }
+
+    size_t available() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    size_t space() const {
+        return capacity - available();
+    }
+
+    size_t write(const uint8_t* src, size_t n) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t h = head.load(std::memory_order_acquire);
+        n = std::min(n, capacity - (size_t)(t - h));
+        n -= n % align;
+        size_t pos = t % capacity;
+        size_t first = std::min(n, capacity - pos);
+        memcpy(data.data() + pos, src, first);
+        memcpy(data.data(), src + first, n - first);
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    size_t read(uint8_t* dst, size_t n) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        uint64_t t = tail.load(std::memory_order_acquire);
+        n = std::min(n, (size_t)(t - h));
+        n -= n % align;
+        size_t pos = h % capacity;
+        size_t first = std::min(n, capacity - pos);
+        memcpy(dst, data.data() + pos, first);
+        memcpy(dst + first, data.data(), n - first);
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    // consumer side, drops everything buffered so far
+    void discard() {
+        head.store(tail.load(std::memory_order_acquire), std::memory_order_release);
+    }
+};
+
+}
+
+#endif // AUDIORING_HPP
@@ -0,0 +1,271 @@
+/********************************************************************
+* libavio/include/BatchDecoder.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef BATCHDECODER_HPP
+#define BATCHDECODER_HPP
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "Frame.hpp"
+#include "Queue.hpp"
+#include "FrameReader.hpp"
+
+namespace avio {
+
+// A file, or with gop_parallel a span of it that starts on a key frame
+struct BatchTask {
+    int file = -1;                      // negative tells a worker to exit
+    int chunk = 0;
+    int64_t start = 0;                  // milliseconds
+    int64_t end = INT64_MAX;
+};
+
+// Delivery state of one file. Chunks are decoded in any order, but frames are handed to the callback in
+// stream order, the chunk at the front delivers directly and the chunks behind it buffer a few frames
+// and then wait their turn.
+struct BatchFile {
+    std::string uri;
+    int chunks = 1;
+    int delivering = 0;
+    std::map<int, std::deque<std::pair<Frame, int64_t>>> buffered;
+    std::map<int, bool> done;
+    bool failed = false;
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+// Decodes a list of files on a fixed pool of workers, each running a FrameReader on its own thread with no
+// pacing. Files are taken in order, one per worker. With gop_parallel each file is also split at key frames
+// into spans of chunk_seconds that are decoded side by side, which is only safe for closed GOP or intra
+// refresh streams, where no frame refers back across a key frame. Tasks are taken first in first out, so
+// the earliest undelivered chunk of a file is always running and the waiting chunks can't stall the pool.
+
+class BatchDecoder {
+public:
+    std::vector<std::string> uris;
+    std::string filter_description;
+    std::string hw_device_type;
+    int workers = 0;                    // defaults to the number of cores
+    bool gop_parallel = false;
+    int chunk_seconds = 60;
+    size_t max_buffered = 32;           // frames held per waiting chunk
+
+    std::function<void(const Frame& f, int64_t time, const std::string& uri)> frameCallback = nullptr;
+    std::function<void(const std::string& uri)> fileFinished = nullptr;
+    std::function<void(const std::string& msg, const std::string& uri)> errorCallback = nullptr;
+
+    std::vector<BatchFile*> files;
+    Queue<BatchTask> tasks;
+    std::atomic<int> outstanding { 0 };
+    std::atomic<bool> cancelled { false };
+    std::atomic<int64_t> frames { 0 };
+    int pool_size = 1;
+    bool running = false;
+
+    BatchDecoder(const std::vector<std::string>& uris, const std::string& filter_description = "format=rgb24", int workers = 0)
+        : uris(uris), filter_description(filter_description), workers(workers) {
+        // made up front so that cancel() can go through them while run() is starting on another thread
+        for (const std::string& uri : uris) {
+            BatchFile* file = new BatchFile();
+            file->uri = uri;
+            files.push_back(file);
+        }
+    }
+
+    ~BatchDecoder() {
+        for (BatchFile* file : files)
+            delete file;
+    }
+
+    void start() {
+        std::thread thread([&]() { run(); });
+        thread.detach();
+    }
+
+    void cancel() {
+        cancelled = true;
+        for (BatchFile* file : files)
+            file->cv.notify_all();
+    }
+
+    // blocks until every file has been decoded
+    void run() {
+        running = true;
+        pool_size = workers > 0 ? workers : std::max(1, (int)std::thread::hardware_concurrency());
+        if (files.empty()) {
+            running = false;
+            return;
+        }
+        for (size_t i = 0; i < files.size(); i++)
+            add_task({ (int)i, 0, 0, INT64_MAX });
+
+        std::vector<std::thread*> threads;
+        for (int i = 0; i < pool_size; i++)
+            threads.push_back(new std::thread([&] { while (work()) {} }));
+        for (std::thread* thread : threads) {
+            thread->join();
+            delete thread;
+        }
+        running = false;
+    }
+
+    void add_task(const BatchTask& task) {
+        outstanding++;
+        tasks.push(BatchTask(task));
+    }
+
+    int work() {
+        BatchTask task = tasks.pop();
+        if (task.file < 0)
+            return 0;
+
+        BatchFile* file = files[task.file];
+        try {
+            if (!cancelled)
+                decode(task, file);
+        }
+        catch (const std::exception& e) {
+            std::stringstream str;
+            str << file->uri << " batch decode error: " << e.what();
+            if (errorCallback) errorCallback(str.str(), file->uri);
+            else std::cout << str.str() << std::endl;
+            std::lock_guard<std::mutex> lock(file->mutex);
+            file->failed = true;
+        }
+        finish(file, task.chunk);
+
+        // the last task out releases the workers
+        if (--outstanding == 0) {
+            for (int i = 0; i < pool_size; i++)
+                tasks.push(BatchTask());
+        }
+        return 1;
+    }
+
+    void decode(const BatchTask& task, BatchFile* file) {
+        FrameReader reader(file->uri, filter_description, hw_device_type);
+
+        if (task.chunk == 0 && gop_parallel) {
+            // the first worker on a file plans the chunks and keeps the first one for itself
+            std::vector<int64_t> bounds = chunk_bounds(reader);
+            {
+                std::lock_guard<std::mutex> lock(file->mutex);
+                file->chunks = (int)bounds.size() + 1;
+            }
+            for (size_t i = 0; i < bounds.size(); i++)
+                add_task({ task.file, (int)i + 1, bounds[i], i + 1 < bounds.size() ? bounds[i + 1] : INT64_MAX });
+            if (bounds.size())
+                return decode_span(reader, file, 0, 0, bounds[0]);
+        }
+
+        if (task.start > 0)
+            reader.seek(task.start);
+        decode_span(reader, file, task.chunk, task.start, task.end);
+    }
+
+    void decode_span(FrameReader& reader, BatchFile* file, int chunk, int64_t start, int64_t end) {
+        while (!cancelled) {
+            Frame f = reader.next();
+            if (f.is_null())
+                break;
+            int64_t time = reader.time(f);
+            if (time >= end)
+                break;
+            if (time < start)
+                continue;
+            frames++;
+            deliver(file, chunk, std::move(f), time);
+        }
+    }
+
+    // key frame times that split the file into spans of about chunk_seconds, empty if the file has no index
+    std::vector<int64_t> chunk_bounds(FrameReader& reader) {
+        std::vector<int64_t> result;
+        int64_t duration = reader.duration();
+        int64_t span = (int64_t)std::max(1, chunk_seconds) * 1000;
+        AVStream* stream = reader.reader->fmt_ctx->streams[reader.reader->video_stream_index];
+        for (int64_t t = span; t < duration; t += span) {
+            int64_t key = key_frame_before_compat(stream, reader.reader->pts_from_real_time(stream->index, t));
+            if (key == AV_NOPTS_VALUE)
+                continue;
+            int64_t time = reader.reader->real_time(stream->index, key);
+            if (time > 0 && (result.empty() || time > result.back()))
+                result.push_back(time);
+        }
+        return result;
+    }
+
+    void deliver(BatchFile* file, int chunk, Frame&& f, int64_t time) {
+        std::unique_lock<std::mutex> lock(file->mutex);
+        file->cv.wait(lock, [&] { return cancelled || chunk == file->delivering || file->buffered[chunk].size() < max_buffered; });
+        if (cancelled)
+            return;
+        if (chunk == file->delivering)
+            callback(file, f, time);
+        else
+            file->buffered[chunk].emplace_back(std::move(f), time);
+    }
+
+    // marks a chunk complete and hands over delivery to the chunks behind it
+    void finish(BatchFile* file, int chunk) {
+        bool finished = false;
+        {
+            std::lock_guard<std::mutex> lock(file->mutex);
+            file->done[chunk] = true;
+            while (file->delivering < file->chunks && file->done[file->delivering]) {
+                file->buffered.erase(file->delivering);
+                file->done.erase(file->delivering);
+                file->delivering++;
+                auto it = file->buffered.find(file->delivering);
+                if (it != file->buffered.end()) {
+                    for (auto& entry : it->second)
+                        if (!cancelled) callback(file, entry.first, entry.second);
+                    it->second.clear();
+                }
+            }
+            finished = file->delivering == file->chunks && !file->failed;
+            file->cv.notify_all();
+        }
+        if (finished && fileFinished && !cancelled)
+            fileFinished(file->uri);
+    }
+
+    // called with the file lock held, so the frames of a file arrive one at a time and in order
+    void callback(BatchFile* file, const Frame& f, int64_t time) {
+        if (!frameCallback) return;
+        try {
+            frameCallback(f, time, file->uri);
+        }
+        catch (const std::exception& e) {
+            std::cout << file->uri << " batch frame callback error: " << e.what() << std::endl;
+        }
+    }
+
+};
+
+}
+
+#endif // BATCHDECODER_HPP
@@ -0,0 +1,142 @@
+/********************************************************************
+* libavio/include/Cache.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <vector>
+#include <deque>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include "Exception.hpp"
+
+namespace avio {
+
+// Time bounded ring of packets used by the Writer as the pre-record buffer. Each slot owns an AVPacket
+// that is allocated once and then reused, packets enter and leave the ring by moving their references,
+// so steady state operation does no allocation. The ring is not locked, it belongs to the writer thread.
+
+class Cache {
+public:
+    std::vector<AVPacket*> slots;
+    std::vector<int64_t> times;         // real time of each slot in milliseconds
+    std::deque<uint64_t> key_frames;    // sequence numbers of the key frames currently in the ring
+    size_t head = 0;
+    size_t count = 0;
+    uint64_t first_seq = 0;             // sequence number of the packet at head
+    int key_stream = -1;                // when set, only key frames of this stream are tracked
+    ExceptionChecker ex;
+
+    explicit Cache(size_t capacity = 256) {
+        slots.resize(capacity, nullptr);
+        times.resize(capacity, -1);
+    }
+
+    ~Cache() {
+        for (AVPacket* slot : slots) {
+            if (slot) av_packet_free(&slot);
+        }
+    }
+
+    size_t  size()        const { return count; }
+    bool    empty()       const { return count == 0; }
+    AVPacket* front()     const { return count ? slots[head] : nullptr; }
+    int64_t front_time()  const { return count ? times[head] : -1; }
+    int64_t back_time()   const { return count ? times[(head + count - 1) % slots.size()] : -1; }
+    int64_t duration()    const { return count ? back_time() - front_time() : 0; }
+
+    uint64_t end_seq()    const { return first_seq + count; }
+    AVPacket* at(uint64_t seq) const { return slots[(head + (seq - first_seq)) % slots.size()]; }
+
+    int64_t time_of(uint64_t seq) const {
+        return times[(head + (seq - first_seq)) % slots.size()];
+    }
+
+    // the reference held by pkt is moved into the ring leaving pkt blank, unless the packet is shared
+    // with other caches, in which case the ring takes a new reference to the same data
+    void push(AVPacket* pkt, int64_t time, bool shared = false) {
+        if (count == slots.size()) grow();
+        size_t index = (head + count) % slots.size();
+        if (!slots[index]) ex.ck((slots[index] = av_packet_alloc()), APA);
+        if (shared)
+            ex.ck(av_packet_ref(slots[index], pkt), APR);
+        else
+            av_packet_move_ref(slots[index], pkt);
+        if (time < 0) time = back_time();
+        times[index] = time;
+        if ((slots[index]->flags & AV_PKT_FLAG_KEY) && (key_stream < 0 || slots[index]->stream_index == key_stream))
+            key_frames.push_back(first_seq + count);
+        count++;
+    }
+
+    // whatever reference is left at the front is released, writing the front packet beforehand consumes it
+    void pop_front() {
+        if (!count) return;
+        av_packet_unref(slots[head]);
+        if (key_frames.size() && key_frames.front() == first_seq)
+            key_frames.pop_front();
+        head = (head + 1) % slots.size();
+        first_seq++;
+        count--;
+    }
+
+    void drop_until(uint64_t seq) {
+        while (count && first_seq < seq)
+            pop_front();
+    }
+
+    // Whole groups of pictures are dropped from the front for as long as the ring, starting from the
+    // next key frame, still spans the window. The front of the ring is always left on a key frame.
+    void trim_to_key_frames(int64_t window) {
+        if (key_frames.empty()) return;
+        int64_t now = back_time();
+        while (key_frames.size() > 1 && now - time_of(key_frames[1]) >= window)
+            drop_until(key_frames[1]);
+        drop_until(key_frames.front());
+    }
+
+    void trim_before(int64_t time) {
+        while (count && times[head] < time)
+            pop_front();
+    }
+
+    void clear() {
+        while (count) pop_front();
+    }
+
+    void grow() {
+        size_t capacity = slots.size();
+        std::vector<AVPacket*> new_slots(capacity * 2, nullptr);
+        std::vector<int64_t> new_times(capacity * 2, -1);
+        for (size_t i = 0; i < capacity; i++) {
+            new_slots[i] = slots[(head + i) % capacity];
+            new_times[i] = times[(head + i) % capacity];
+        }
+        slots.swap(new_slots);
+        times.swap(new_times);
+        head = 0;
+    }
+};
+
+}
+
+#endif // CACHE_HPP
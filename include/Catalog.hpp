@@ -0,0 +1,211 @@
+/********************************************************************
+* libavio/include/Catalog.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef CATALOG_HPP
+#define CATALOG_HPP
+
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+
+namespace avio {
+
+// One line per event is appended to a plain text index, with the fields separated by tabs
+//
+//   S  file  uri  start_ms                 a recording has started
+//   K  file  wall_ms  media_ms  offset     key frame, offset is the byte position in the file, -1 if unknown
+//   E  file  end_ms                        a recording is complete
+//
+// Times are wall clock milliseconds since the epoch. Each line goes out in a single append, so several
+// players may share the same index. A file without an E line was cut short, its last key frame marks
+// the end of the usable footage.
+
+struct CatalogKey {
+    int64_t wall = 0;
+    int64_t media = 0;
+    int64_t offset = -1;
+};
+
+struct CatalogFile {
+    std::string filename;
+    std::string uri;
+    int64_t start = -1;
+    int64_t end = -1;
+    std::vector<CatalogKey> key_frames;
+
+    int64_t last_time() const {
+        if (end >= 0) return end;
+        return key_frames.size() ? key_frames.back().wall : start;
+    }
+};
+
+// the place to begin reading a file in order to cover the start of a requested time range
+struct CatalogHit {
+    std::string filename;
+    std::string uri;
+    int64_t start = -1;
+    int64_t end = -1;
+    int64_t key_frame_time = -1;
+    int64_t media_time = 0;
+    int64_t offset = -1;
+    bool complete = false;
+};
+
+class Catalog {
+public:
+    std::string path;
+    FILE* fp = nullptr;
+    std::mutex mutex;
+
+    // lookup state, the index is append only so it is read incrementally
+    std::map<std::string, CatalogFile> files;
+    std::vector<std::string> order;
+    long read_pos = 0;
+
+    Catalog(const std::string& path) : path(path) { }
+
+    ~Catalog() {
+        if (fp) fclose(fp);
+    }
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    void start(const std::string& filename, const std::string& uri, int64_t start_ms) {
+        std::stringstream str;
+        str << "S\t" << filename << "\t" << uri << "\t" << start_ms << "\n";
+        append(str.str());
+    }
+
+    void key_frame(const std::string& filename, int64_t wall_ms, int64_t media_ms, int64_t offset) {
+        std::stringstream str;
+        str << "K\t" << filename << "\t" << wall_ms << "\t" << media_ms << "\t" << offset << "\n";
+        append(str.str());
+    }
+
+    void end(const std::string& filename, int64_t end_ms) {
+        std::stringstream str;
+        str << "E\t" << filename << "\t" << end_ms << "\n";
+        append(str.str());
+    }
+
+    void append(const std::string& line) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!fp) {
+            if (!(fp = fopen(path.c_str(), "a"))) {
+                std::cout << "unable to open catalog " << path << std::endl;
+                return;
+            }
+        }
+        fwrite(line.data(), 1, line.size(), fp);
+        fflush(fp);
+    }
+
+    // Files of the given uri, all uris if empty, that overlap the range, in the order they were started.
+    // Each hit carries the last key frame at or before the start of the range.
+    std::vector<CatalogHit> lookup(const std::string& uri, int64_t start_ms, int64_t end_ms) {
+        std::lock_guard<std::mutex> lock(mutex);
+        refresh();
+        std::vector<CatalogHit> result;
+        for (const std::string& filename : order) {
+            const CatalogFile& file = files[filename];
+            if (!uri.empty() && file.uri != uri) continue;
+            if (file.start > end_ms || file.last_time() < start_ms) continue;
+
+            CatalogHit hit;
+            hit.filename = file.filename;
+            hit.uri = file.uri;
+            hit.start = file.start;
+            hit.end = file.last_time();
+            hit.complete = file.end >= 0;
+            for (const CatalogKey& key : file.key_frames) {
+                if (key.wall > start_ms && hit.key_frame_time >= 0) break;
+                hit.key_frame_time = key.wall;
+                hit.media_time = key.media;
+                hit.offset = key.offset;
+            }
+            result.push_back(hit);
+        }
+        return result;
+    }
+
+    void refresh() {
+        FILE* in = fopen(path.c_str(), "r");
+        if (!in) return;
+        if (fseek(in, read_pos, SEEK_SET)) {
+            fclose(in);
+            return;
+        }
+        char buf[4096];
+        while (fgets(buf, sizeof(buf), in)) {
+            std::string line(buf);
+            // a partial line belongs to a write still in progress, it is read again next time
+            if (line.empty() || line.back() != '\n') break;
+            line.pop_back();
+            parse(line);
+            read_pos = ftell(in);
+        }
+        fclose(in);
+    }
+
+    void parse(const std::string& line) {
+        std::vector<std::string> fields;
+        std::stringstream str(line);
+        std::string field;
+        while (std::getline(str, field, '\t'))
+            fields.push_back(field);
+        if (fields.size() < 3) return;
+
+        try {
+            const std::string& filename = fields[1];
+            if (fields[0] == "S" && fields.size() == 4) {
+                if (!files.count(filename)) order.push_back(filename);
+                CatalogFile& file = files[filename];
+                file = CatalogFile();
+                file.filename = filename;
+                file.uri = fields[2];
+                file.start = std::stoll(fields[3]);
+            }
+            else if (fields[0] == "K" && fields.size() == 5 && files.count(filename)) {
+                CatalogKey key;
+                key.wall = std::stoll(fields[2]);
+                key.media = std::stoll(fields[3]);
+                key.offset = std::stoll(fields[4]);
+                files[filename].key_frames.push_back(key);
+            }
+            else if (fields[0] == "E" && files.count(filename)) {
+                files[filename].end = std::stoll(fields[2]);
+            }
+        }
+        catch (const std::exception& e) {
+            std::cout << "catalog " << path << " bad entry: " << line << std::endl;
+        }
+    }
+};
+
+}
+
+#endif // CATALOG_HPP
@@ -0,0 +1,232 @@
+/********************************************************************
+* libavio/include/Clock.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef CLOCK_HPP
+#define CLOCK_HPP
+
+#include <cstdint>
+#include <climits>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace avio {
+
+// A media time in milliseconds that keeps running between updates. The extrapolation is capped, so a
+// clock that stops being fed, such as audio during an underrun, holds still rather than running away.
+
+class Clock {
+public:
+    int64_t time = INT64_MIN;
+    int64_t updated = 0;                // steady clock microseconds at the last update
+    int64_t max_extrapolation = INT64_MAX;
+    mutable std::mutex mutex;
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void set(int64_t arg) {
+        std::lock_guard<std::mutex> lock(mutex);
+        time = arg;
+        updated = now();
+    }
+
+    int64_t get() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (time == INT64_MIN) return INT64_MIN;
+        return time + std::min((now() - updated) / 1000, max_extrapolation);
+    }
+
+    // the last value set, without extrapolation
+    int64_t last() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return time;
+    }
+
+    bool valid() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return time != INT64_MIN;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        time = INT64_MIN;
+    }
+};
+
+enum SyncMaster {
+    SYNC_AUDIO,
+    SYNC_VIDEO,
+    SYNC_WALL
+};
+
+// Presentation of video is timed against one master clock.
+//
+//   audio  the time of the sample being heard, video waits for it or is dropped when it falls behind
+//   video  the time of the last frame shown, playback slows down under load rather than dropping frames
+//   wall   real time anchored at the first frame, slewed gently toward the stream to absorb drift
+//
+// A frame later than the threshold is dropped, before the filter where possible, so an overloaded box
+// skips pictures instead of accumulating lag. A zero threshold turns dropping off.
+
+class SyncClock {
+public:
+    Clock audio;
+    Clock video;
+    Clock wall;
+    SyncMaster master = SYNC_AUDIO;
+    int64_t late_threshold = 0;         // milliseconds
+    int64_t max_wait = 1000;            // longer waits mean the master has jumped, the clocks are re-anchored
+    std::atomic<int64_t> dropped { 0 };
+
+    SyncClock() {
+        // an audio clock is updated at least once per device buffer, beyond that it is assumed stalled
+        audio.max_extrapolation = 200;
+    }
+
+    static SyncMaster master_from_string(const std::string& arg, bool has_audio) {
+        if (arg == "video") return SYNC_VIDEO;
+        if (arg == "wall")  return SYNC_WALL;
+        return has_audio ? SYNC_AUDIO : SYNC_VIDEO;
+    }
+
+    int64_t time() const {
+        switch (master) {
+            case SYNC_AUDIO: return audio.get();
+            case SYNC_VIDEO: return video.get();
+            case SYNC_WALL:  return wall.get();
+        }
+        return INT64_MIN;
+    }
+
+    // milliseconds until the frame is due, negative when it is late, zero when there is no clock yet
+    int64_t delay(int64_t frame_time) const {
+        int64_t now = time();
+        if (now == INT64_MIN || frame_time == INT64_MIN) return 0;
+        return frame_time - now;
+    }
+
+    bool late(int64_t frame_time) const {
+        if (late_threshold <= 0 || master == SYNC_VIDEO) return false;
+        return delay(frame_time) < -late_threshold;
+    }
+
+    // called once a frame is on screen
+    void presented(int64_t frame_time) {
+        video.set(frame_time);
+        if (!wall.valid()) {
+            wall.set(frame_time);
+        }
+        else {
+            // small differences are drift between the stream and real time, larger ones are left for
+            // the late frame policy to deal with
+            int64_t drift = frame_time - wall.get();
+            if (drift > max_wait || drift < -max_wait)
+                wall.set(frame_time);
+            else if (late_threshold <= 0 || (drift < late_threshold && drift > -late_threshold))
+                wall.set(wall.get() + drift / 16);
+        }
+    }
+
+    // the timeline has jumped, as after a seek
+    void reset() {
+        audio.reset();
+        video.reset();
+        wall.reset();
+    }
+
+    // the master clock is ahead by more than makes sense, start again from this frame
+    void anchor(int64_t frame_time) {
+        video.set(frame_time);
+        wall.set(frame_time);
+    }
+};
+
+// Measures how long video spends inside the process, from the packet coming off the network to the frame
+// going on screen. Camera encode and network transit are not visible here, so this is the part of the glass
+// to glass delay that the pipeline adds. The backlog is the age of the oldest packet not yet presented,
+// which keeps growing when the pipeline stalls even though nothing reaches the screen.
+
+class LatencyMeter {
+public:
+    struct Entry {
+        int64_t time;
+        int64_t arrival;                // steady clock microseconds
+    };
+
+    std::vector<Entry> ring;
+    uint64_t count = 0;
+    int64_t shown = INT64_MIN;
+    int64_t last = -1;                  // milliseconds, the most recent frame
+    double average = -1;                // milliseconds, smoothed
+    mutable std::mutex mutex;
+
+    LatencyMeter(size_t size = 256) : ring(size) { }
+
+    void arrived(int64_t time) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ring[count++ % ring.size()] = { time, Clock::now() };
+    }
+
+    void presented(int64_t time) {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t first = count > ring.size() ? count - ring.size() : 0;
+        for (uint64_t i = count; i > first; i--) {
+            const Entry& entry = ring[(i - 1) % ring.size()];
+            if (entry.time == time) {
+                last = (Clock::now() - entry.arrival) / 1000;
+                average = average < 0 ? last : average + (last - average) / 8;
+                shown = time;
+                return;
+            }
+        }
+    }
+
+    int64_t backlog() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (shown == INT64_MIN) return 0;
+        uint64_t first = count > ring.size() ? count - ring.size() : 0;
+        for (uint64_t i = first; i < count; i++) {
+            const Entry& entry = ring[i % ring.size()];
+            if (entry.time > shown)
+                return (Clock::now() - entry.arrival) / 1000;
+        }
+        return 0;
+    }
+
+    // everything before time has been thrown away
+    void skip_to(int64_t time) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (shown != INT64_MIN) shown = time - 1;
+    }
+
+    int64_t estimate() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return (int64_t)average;
+    }
+};
+
+}
+
+#endif // CLOCK_HPP
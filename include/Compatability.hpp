@@ -43,6 +43,13 @@ namespace avio {
 #define AVIO_HAS_SWR_ALLOC_SET_OPTS2 0
 #endif
 
+// the buffer passed to a custom AVIOContext write callback became const in FFmpeg 7
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+#define AVIO_WRITE_CONST const
+#else
+#define AVIO_WRITE_CONST
+#endif
+
 #if LIBAVCODEC_VERSION_MAJOR >= 59
 #define AVIO_HAS_FRAME_TIME_BASE 1
 #define AVIO_HAS_PACKET_TIME_BASE 1
@@ -78,6 +85,25 @@ inline int channel_count_from_codecctx(const AVCodecContext* codec_ctx) {
 #endif
 }
 
+inline void set_channels_compat(AVCodecContext* codec_ctx, int channels) {
+#if AVIO_HAS_CH_LAYOUT
+    av_channel_layout_uninit(&codec_ctx->ch_layout);
+    av_channel_layout_default(&codec_ctx->ch_layout, channels);
+#else
+    codec_ctx->channels = channels;
+    codec_ctx->channel_layout = av_get_default_channel_layout(channels);
+#endif
+}
+
+inline void set_frame_channels_compat(AVFrame* frame, const AVCodecContext* codec_ctx) {
+#if AVIO_HAS_CH_LAYOUT
+    av_channel_layout_copy(&frame->ch_layout, &codec_ctx->ch_layout);
+#else
+    frame->channels = codec_ctx->channels;
+    frame->channel_layout = codec_ctx->channel_layout;
+#endif
+}
+
 inline uint64_t channel_mask_from_codecpar(const AVCodecParameters* codecpar) {
     if (!codecpar) return 0;
 
@@ -230,6 +256,46 @@ inline int swr_alloc_set_opts_compat(
 #endif
 }
 
+// as above, converting to a given number of channels in their default layout
+inline int swr_alloc_set_opts_compat(
+    SwrContext** swr_ctx,
+    const AVCodecParameters* codecpar,
+    AVSampleFormat out_fmt,
+    int out_rate,
+    int out_channels
+) {
+#if AVIO_HAS_SWR_ALLOC_SET_OPTS2
+    AVChannelLayout in_ch_layout  = {};
+    AVChannelLayout out_ch_layout = {};
+
+    int ret = av_channel_layout_copy(&in_ch_layout, &codecpar->ch_layout);
+    if (ret < 0)
+        return ret;
+
+    av_channel_layout_default(&out_ch_layout, out_channels);
+
+    ret = swr_alloc_set_opts2(
+        swr_ctx,
+        &out_ch_layout, out_fmt, out_rate,
+        &in_ch_layout, static_cast<AVSampleFormat>(codecpar->format), codecpar->sample_rate,
+        0, nullptr
+    );
+
+    av_channel_layout_uninit(&out_ch_layout);
+    av_channel_layout_uninit(&in_ch_layout);
+    return ret;
+#else
+    uint64_t mask = channel_mask_from_codecpar(codecpar);
+    *swr_ctx = swr_alloc_set_opts(
+        *swr_ctx,
+        av_get_default_channel_layout(out_channels), out_fmt, out_rate,
+        static_cast<int64_t>(mask), static_cast<AVSampleFormat>(codecpar->format), codecpar->sample_rate,
+        0, nullptr
+    );
+    return (*swr_ctx) ? 0 : AVERROR(ENOMEM);
+#endif
+}
+
 /*
 inline int swr_alloc_set_opts_compat(
     SwrContext** swr_ctx,
@@ -279,6 +345,30 @@ inline int find_best_stream_compat(
 #endif
 }
 
+// timestamp of the key frame at or before timestamp in the demuxer index of the stream, AV_NOPTS_VALUE
+// when the index doesn't cover it. The index entries became private in FFmpeg 4.4.
+inline int64_t key_frame_before_compat(AVStream* stream, int64_t timestamp) {
+#if LIBAVFORMAT_VERSION_MAJOR > 58 || (LIBAVFORMAT_VERSION_MAJOR == 58 && LIBAVFORMAT_VERSION_MINOR >= 78)
+    const AVIndexEntry* entry = avformat_index_get_entry_from_timestamp(stream, timestamp, AVSEEK_FLAG_BACKWARD);
+    return entry ? entry->timestamp : AV_NOPTS_VALUE;
+#else
+    int index = av_index_search_timestamp(stream, timestamp, AVSEEK_FLAG_BACKWARD);
+    return index < 0 ? AV_NOPTS_VALUE : stream->index_entries[index].timestamp;
+#endif
+}
+
+// AVFormatContext.io_close2 replaced io_close, which had no return value, in FFmpeg 5.0
+typedef int (*io_close_compat_fn)(AVFormatContext* s, AVIOContext* pb);
+
+template <io_close_compat_fn fn>
+inline void set_io_close_compat(AVFormatContext* fmt_ctx) {
+#if LIBAVFORMAT_VERSION_MAJOR > 59 || (LIBAVFORMAT_VERSION_MAJOR == 59 && LIBAVFORMAT_VERSION_MINOR >= 16)
+    fmt_ctx->io_close2 = fn;
+#else
+    fmt_ctx->io_close = [](AVFormatContext* s, AVIOContext* pb) { fn(s, pb); };
+#endif
+}
+
 } // namespace avio
 
 #endif // COMPATABILITY_HPP
\ No newline at end of file
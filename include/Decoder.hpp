@@ -21,6 +21,7 @@
 #define DECODER_HPP
 
 #include <iostream>
+#include <functional>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -65,7 +66,10 @@ public:
     AVHWDeviceType hw_type;
     AVBufferRef* hw_device_ctx = nullptr;
 
-    Decoder(Reader* reader, AVMediaType media_type, Queue<Packet>* pkts, Queue<Frame>* frames, AVHWDeviceType hw_type=AV_HWDEVICE_TYPE_NONE) 
+    // analysis stages see each decoded frame in system memory on the decoder thread, before it is queued
+    std::function<void(const AVFrame*)> frame_handle = nullptr;
+
+    Decoder(Reader* reader, AVMediaType media_type, Queue<Packet>* pkts, Queue<Frame>* frames, AVHWDeviceType hw_type=AV_HWDEVICE_TYPE_NONE, bool low_delay=false) 
             : reader(reader), media_type(media_type), pkts(pkts), frames(frames), hw_type(hw_type) {
 
         const char* str = av_get_media_type_string(media_type);
@@ -98,6 +102,16 @@ public:
             ex.ck(sw_frame = av_frame_alloc(), AFA);
         }
 
+        if (low_delay) {
+            // frame threading holds back one frame per thread, slices are decoded in parallel without delay
+            codec_ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+            codec_ctx->flags2 |= AV_CODEC_FLAG2_FAST;
+            codec_ctx->thread_type = FF_THREAD_SLICE;
+        }
+
+        if (media_type == AVMEDIA_TYPE_VIDEO && reader->activity && reader->activity->motion_vectors)
+            codec_ctx->flags2 |= AV_CODEC_FLAG2_EXPORT_MVS;
+
         ex.ck(avcodec_open2(codec_ctx, decoder, nullptr), AO2);
         ex.ck(av_frame = av_frame_alloc(), AFA);
     }
@@ -130,17 +144,24 @@ public:
         if (reader->seek_pts != AV_NOPTS_VALUE) 
             return 1;
 
+        if (media_type == AVMEDIA_TYPE_VIDEO && !pkt.is_null())
+            adjust_skip(pkt);
+
         try {
             int ret = -1;
             ex.ck((ret = avcodec_send_packet(codec_ctx, pkt.pkt)), ASP);
             while ((ret = avcodec_receive_frame(codec_ctx, av_frame)) >= 0) {
+                if (media_type == AVMEDIA_TYPE_VIDEO && reader->activity && reader->activity->motion_vectors)
+                    reader->activity->frame(av_frame);
                 if (av_frame->format == hw_pix_fmt) {
                     ex.ck(av_hwframe_transfer_data(sw_frame, av_frame, 0), AHTD);
                 	ex.ck(av_frame_copy_props(sw_frame, av_frame), AFCP);
+                    if (frame_handle) frame_handle(sw_frame);
                     frames->push(Frame(sw_frame));
                     Frame term(av_frame);
                 }
                 else {
+                    if (frame_handle) frame_handle(av_frame);
                     frames->push(Frame(av_frame));
                 }
             }
@@ -165,6 +186,17 @@ public:
 
         return 1;
     }
+
+    // Frames that are far behind the master clock would only be dropped after decoding, so the decoder is
+    // told to skip the non reference frames until it catches up. Reference frames are always decoded to
+    // keep the picture intact.
+    void adjust_skip(const Packet& pkt) {
+        int64_t threshold = reader->clock.late_threshold;
+        if (threshold <= 0 || (reader->live_stream && !reader->is_timeshifting() && !reader->drop_late_live))
+            return;
+        int64_t delay = reader->clock.delay(reader->real_time(stream_index, pkt.pts()));
+        codec_ctx->skip_frame = delay < -4 * threshold ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    }
 };
 
 }
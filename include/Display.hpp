@@ -40,6 +40,7 @@ public:
     Reader* reader = nullptr;
     Queue<Frame>* frames = nullptr;
     Frame last_frame;
+    int64_t last_time = -1;             // stream time of the frame on screen in milliseconds
     bool one_shot = false;
     ExceptionChecker ex;
     
@@ -111,6 +112,9 @@ public:
         }
 
         if (reader->paused && !one_shot) {
+            // the clocks run on from wherever playback resumes
+            reader->clock.video.reset();
+            reader->clock.wall.reset();
             show_frame(last_frame);
             std::this_thread::sleep_for(std::chrono::milliseconds(100));
         }
@@ -123,11 +127,30 @@ public:
             if (reader->seek_pts != AV_NOPTS_VALUE)
                 return 1;
 
-            if (!reader->live_stream) {
-                wait(f.pts());
+            int64_t rts = reader->real_time(reader->video_stream_index, f.pts());
+            if (reader->is_timeshifting() && rts < reader->timeshift->resume_time) {
+                // decoding restarted at the key frame before the resume point, those frames were already seen
+                return 1;
+            }
+
+            if (!reader->live_stream || reader->is_timeshifting()) {
+                if (!wait(rts)) {
+                    // too late to be worth showing, the next frame may still make it
+                    reader->clock.dropped++;
+                    return 1;
+                }
+            }
+            else if (reader->drop_late_live && reader->clock.late(rts)) {
+                // live frames are not held back, only the late ones are dropped
+                reader->clock.dropped++;
+                return 1;
             }
 
             show_frame(f);
+            last_time = rts;
+            reader->clock.presented(rts);
+            if (reader->latency_target > 0)
+                reader->latency.presented(rts);
             
             last_frame = std::move(f);
             one_shot = false;
@@ -135,19 +158,18 @@ public:
         return 1;
     }
 
-    void wait(int64_t pts) {
-        if (reader->has_audio() && !reader->disable_audio) {
-            int64_t rts = reader->real_time(reader->video_stream_index, pts);
-            int64_t diff = rts - reader->last_audio_rts;
-            if (diff > 0 && diff < 1000)
-                std::this_thread::sleep_for(std::chrono::milliseconds(diff));
+    // holds the frame until it is due on the master clock, returns false if it is too late to show
+    bool wait(int64_t rts) {
+        int64_t delay = reader->clock.delay(rts);
+        if (delay > reader->clock.max_wait) {
+            reader->clock.anchor(rts);
+            return true;
         }
-        else {
-            int64_t pts_diff = pts - last_frame.pts();
-            int64_t diff = reader->real_time(reader->video_stream_index, pts_diff);
-            if (diff > 0 && diff < 1000)
-                std::this_thread::sleep_for(std::chrono::milliseconds(diff));
+        if (delay > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+            return true;
         }
+        return !reader->clock.late(rts);
     }
 
     void poll() {
@@ -166,10 +188,19 @@ public:
                             reader->recording = !reader->recording;
                         break;
                     case SDLK_SPACE:
-                        if (!reader->live_stream)
+                        if (!reader->live_stream) {
                             reader->paused = !reader->paused;
+                        }
+                        else if (reader->timeshift) {
+                            // pausing live playback holds the picture while the stream carries on into the buffer
+                            if (!reader->paused && !reader->is_timeshifting())
+                                reader->timeshift_to(last_time);
+                            reader->paused = !reader->paused;
+                        }
                         break;
                     case SDLK_LEFT:
+                        if (reader->live_stream && reader->timeshift && last_time >= 0)
+                            reader->timeshift_to(last_time - 10000);
                         if (!reader->closed && !reader->live_stream) {
                             reader->seek_pts = last_frame.pts() - 10 * av_q2d(av_inv_q(reader->video_time_base()));
                             if (reader->paused) {
@@ -179,6 +210,8 @@ public:
                         }
                         break;
                     case SDLK_RIGHT:
+                        if (reader->is_timeshifting())
+                            reader->timeshift_to(last_time + 10000);
                         if (!reader->closed && !reader->live_stream) {
                             reader->seek_pts = last_frame.pts() + 10 * av_q2d(av_inv_q(reader->video_time_base()));
                             if (reader->paused) {
@@ -0,0 +1,292 @@
+/********************************************************************
+* libavio/include/Encoder.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef ENCODER_HPP
+#define ENCODER_HPP
+
+#include <atomic>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/opt.h>
+#include <libavutil/audio_fifo.h>
+#include <libswscale/swscale.h>
+#include <libswresample/swresample.h>
+}
+
+#include "Exception.hpp"
+#include "Compatability.hpp"
+#include "Packet.hpp"
+#include "Frame.hpp"
+#include "Queue.hpp"
+#include "Reader.hpp"
+
+namespace avio {
+
+// Encodes filtered frames for the writer when recordings are transcoded rather than copied. The packets
+// stand in for those of the reader stream they were decoded from, they carry its stream index and time
+// base, so the pre-record cache, rollover, the catalog and every output of the fanout work on them
+// unchanged. Each encoder runs on its own thread and the codec can use more threads of its own.
+//
+// The writer numbers packets by their durations, so B frames are turned off and each packet is held back
+// until the next one arrives to measure its duration, which also covers frames dropped upstream.
+
+class Encoder {
+public:
+    Reader* reader = nullptr;
+    AVMediaType media_type;
+    int stream_index = -1;              // the reader stream the output replaces
+    Queue<Frame>* frames = nullptr;
+    Queue<Packet>* pkts = nullptr;
+    std::string str_media_type;
+
+    std::string codec_name;
+    std::string preset = "veryfast";    // x264 and x265
+    int crf = 28;                       // constant quality unless a bit rate is given
+    int64_t bit_rate = 0;
+    int threads = 0;                    // codec threads, zero lets the codec decide
+    int gop_seconds = 2;
+
+    AVCodecContext* codec_ctx = nullptr;
+    SwsContext* sws_ctx = nullptr;
+    SwrContext* swr_ctx = nullptr;
+    AVAudioFifo* fifo = nullptr;
+    AVFrame* cvt_frame = nullptr;
+    AVPacket* pkt = nullptr;
+    AVPacket* held = nullptr;
+    bool holding = false;
+    int64_t last_duration = 0;
+    int64_t next_pts = AV_NOPTS_VALUE;  // audio, in samples
+    std::vector<uint8_t*> samples;
+    int samples_size = 0;
+    std::atomic<bool> opened { false };
+    ExceptionChecker ex;
+
+    Encoder(Reader* reader, AVMediaType media_type, Queue<Frame>* frames, Queue<Packet>* pkts, const std::string& codec_name)
+            : reader(reader), media_type(media_type), frames(frames), pkts(pkts), codec_name(codec_name) {
+        const char* str = av_get_media_type_string(media_type);
+        str_media_type = (str ? str : "unknown media type");
+        stream_index = media_type == AVMEDIA_TYPE_VIDEO ? reader->video_stream_index : reader->audio_stream_index;
+        if (media_type == AVMEDIA_TYPE_AUDIO) bit_rate = 64000;
+        ex.ck(pkt = av_packet_alloc(), APA);
+        ex.ck(held = av_packet_alloc(), APA);
+        ex.ck(cvt_frame = av_frame_alloc(), AFA);
+    }
+
+    ~Encoder() {
+        if (codec_ctx) avcodec_free_context(&codec_ctx);
+        if (sws_ctx) sws_freeContext(sws_ctx);
+        if (swr_ctx) swr_free(&swr_ctx);
+        if (fifo) av_audio_fifo_free(fifo);
+        if (cvt_frame) av_frame_free(&cvt_frame);
+        if (pkt) av_packet_free(&pkt);
+        if (held) av_packet_free(&held);
+        if (samples.size() && samples[0]) av_freep(&samples[0]);
+    }
+
+    int encode() {
+        Frame f = frames->pop();
+
+        if (f.is_null() || reader->terminated) {
+            try {
+                if (opened && !reader->terminated) {
+                    send(nullptr);
+                    release(last_duration);
+                }
+            }
+            catch (const std::exception& e) {
+                std::cout << str_media_type << " encoder flush error: " << e.what() << std::endl;
+            }
+            pkts->push(Packet(nullptr));
+            return 0;
+        }
+
+        try {
+            if (!opened)
+                open(f);
+            if (media_type == AVMEDIA_TYPE_VIDEO)
+                encode_video(f);
+            else
+                encode_audio(f);
+        }
+        catch (const std::exception& e) {
+            std::cout << str_media_type << " encoder error: " << e.what() << std::endl;
+        }
+        return 1;
+    }
+
+    // the codec is configured from the first frame, the writer only asks for parameters after that
+    void open(const Frame& f) {
+        AVStream* stream = reader->fmt_ctx->streams[stream_index];
+        const AVCodec* codec = avcodec_find_encoder_by_name(codec_name.c_str());
+        if (!codec) throw std::runtime_error("encoder " + codec_name + " was not found");
+        ex.ck(codec_ctx = avcodec_alloc_context3(codec), AAC3);
+        codec_ctx->thread_count = threads;
+        codec_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        AVDictionary* opts = nullptr;
+
+        if (media_type == AVMEDIA_TYPE_VIDEO) {
+            codec_ctx->width = f.width();
+            codec_ctx->height = f.height();
+            codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+            codec_ctx->sample_aspect_ratio = f.frame->sample_aspect_ratio;
+            codec_ctx->time_base = stream->time_base;
+            if (stream->avg_frame_rate.num > 0 && stream->avg_frame_rate.den > 0)
+                codec_ctx->framerate = stream->avg_frame_rate;
+            double fps = av_q2d(stream->avg_frame_rate);
+            codec_ctx->gop_size = (fps > 0 && fps < 240) ? (int)(fps * gop_seconds + 0.5) : 50;
+            codec_ctx->max_b_frames = 0;
+            av_dict_set(&opts, "preset", preset.c_str(), 0);
+            if (bit_rate > 0)
+                codec_ctx->bit_rate = bit_rate;
+            else
+                av_dict_set_int(&opts, "crf", crf, 0);
+        }
+        else {
+            AVCodecParameters* codecpar = stream->codecpar;
+            int channels = std::max(1, channel_count_from_codecpar(codecpar));
+            // aac takes planar float at the rate of the source
+            codec_ctx->sample_fmt = AV_SAMPLE_FMT_FLTP;
+            codec_ctx->sample_rate = codecpar->sample_rate;
+            set_channels_compat(codec_ctx, channels);
+            codec_ctx->bit_rate = bit_rate;
+            codec_ctx->time_base = av_make_q(1, codecpar->sample_rate);
+            ex.ck(swr_ctx = swr_alloc());
+            ex.ck(swr_alloc_set_opts_compat(&swr_ctx, codecpar, codec_ctx->sample_fmt, codec_ctx->sample_rate, channels), SASO);
+            ex.ck(swr_init(swr_ctx), SI);
+        }
+
+        int ret = avcodec_open2(codec_ctx, codec, &opts);
+        av_dict_free(&opts);
+        ex.ck(ret, AO2);
+
+        if (media_type == AVMEDIA_TYPE_AUDIO) {
+            int frame_size = codec_ctx->frame_size > 0 ? codec_ctx->frame_size : 1024;
+            ex.ck(fifo = av_audio_fifo_alloc(codec_ctx->sample_fmt, channel_count_from_codecctx(codec_ctx), frame_size), AAFA);
+            cvt_frame->nb_samples = frame_size;
+            cvt_frame->format = codec_ctx->sample_fmt;
+            cvt_frame->sample_rate = codec_ctx->sample_rate;
+            set_frame_channels_compat(cvt_frame, codec_ctx);
+            ex.ck(av_frame_get_buffer(cvt_frame, 0), AFGB);
+        }
+        opened = true;
+    }
+
+    void encode_video(Frame& f) {
+        AVFrame* src = f.frame;
+        if (f.format() != codec_ctx->pix_fmt || f.width() != codec_ctx->width || f.height() != codec_ctx->height) {
+            // filters that change the size mid stream, such as a switch to the main stream, are scaled back
+            ex.ck(sws_ctx = sws_getCachedContext(sws_ctx, f.width(), f.height(), (AVPixelFormat)f.format(),
+                    codec_ctx->width, codec_ctx->height, codec_ctx->pix_fmt, SWS_BILINEAR, nullptr, nullptr, nullptr), SGC);
+            if (!cvt_frame->data[0]) {
+                cvt_frame->width = codec_ctx->width;
+                cvt_frame->height = codec_ctx->height;
+                cvt_frame->format = codec_ctx->pix_fmt;
+                ex.ck(av_frame_get_buffer(cvt_frame, 0), AFGB);
+            }
+            ex.ck(av_frame_make_writable(cvt_frame), AFMW);
+            ex.ck(sws_scale(sws_ctx, src->data, src->linesize, 0, f.height(), cvt_frame->data, cvt_frame->linesize), SS);
+            cvt_frame->pts = src->pts;
+            src = cvt_frame;
+        }
+        // the key frames of the source are not carried over, the encoder places its own
+        src->pict_type = AV_PICTURE_TYPE_NONE;
+        send(src);
+    }
+
+    void encode_audio(Frame& f) {
+        int max_samples = swr_get_out_samples(swr_ctx, f.samples());
+        if (max_samples <= 0)
+            return;
+        int channels = channel_count_from_codecctx(codec_ctx);
+        if (samples_size < max_samples) {
+            if (samples.size() && samples[0]) av_freep(&samples[0]);
+            samples.assign(channels, nullptr);
+            ex.ck(av_samples_alloc(samples.data(), nullptr, channels, max_samples, codec_ctx->sample_fmt, 0), SA);
+            samples_size = max_samples;
+        }
+        int count = 0;
+        ex.ck(count = swr_convert(swr_ctx, samples.data(), max_samples, (const uint8_t**)f.frame->extended_data, f.samples()), SC);
+
+        // the sample count is the clock, it is only moved when the source jumps by more than a second
+        if (f.pts() != AV_NOPTS_VALUE) {
+            int64_t pts = av_rescale_q(f.pts(), reader->fmt_ctx->streams[stream_index]->time_base, codec_ctx->time_base);
+            int64_t expected = next_pts + av_audio_fifo_size(fifo);
+            if (next_pts == AV_NOPTS_VALUE || std::abs(pts - expected) > codec_ctx->sample_rate)
+                next_pts = pts - av_audio_fifo_size(fifo);
+        }
+        if (next_pts == AV_NOPTS_VALUE)
+            return;
+
+        if (av_audio_fifo_write(fifo, (void**)samples.data(), count) < count)
+            ex.ck(AVERROR(ENOMEM), AAFW);
+        while (av_audio_fifo_size(fifo) >= cvt_frame->nb_samples) {
+            ex.ck(av_frame_make_writable(cvt_frame), AFMW);
+            av_audio_fifo_read(fifo, (void**)cvt_frame->data, cvt_frame->nb_samples);
+            cvt_frame->pts = next_pts;
+            next_pts += cvt_frame->nb_samples;
+            send(cvt_frame);
+        }
+    }
+
+    void send(AVFrame* frame) {
+        ex.ck(avcodec_send_frame(codec_ctx, frame), ASFR);
+        int ret = 0;
+        while ((ret = avcodec_receive_packet(codec_ctx, pkt)) >= 0)
+            emit();
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            ex.ck(ret, ARP);
+    }
+
+    void emit() {
+        av_packet_rescale_ts(pkt, codec_ctx->time_base, reader->fmt_ctx->streams[stream_index]->time_base);
+        pkt->stream_index = stream_index;
+        if (holding && pkt->pts > held->pts)
+            release(pkt->pts - held->pts);
+        else if (holding)
+            release(last_duration);
+        av_packet_move_ref(held, pkt);
+        holding = true;
+    }
+
+    void release(int64_t duration) {
+        if (!holding) return;
+        if (duration > 0) {
+            held->duration = duration;
+            last_duration = duration;
+        }
+        pkts->push(Packet(held));
+        holding = false;
+    }
+
+    bool ready() const {
+        return opened;
+    }
+
+    // stream parameters for the writer, the codec is opened by the time packets reach it
+    void parameters(AVCodecParameters* codecpar) {
+        if (!opened) throw std::runtime_error(str_media_type + " encoder is not ready");
+        ex.ck(avcodec_parameters_from_context(codecpar, codec_ctx), APFC);
+    }
+};
+
+}
+
+#endif // ENCODER_HPP
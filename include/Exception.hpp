@@ -99,6 +99,11 @@ enum CmdTag {
     APR,
     APC,
     APCP,
+    ANP,
+    ASFR,
+    AAFA,
+    AAFW,
+    APCO,
     AM,
     SASO,
     SA,
@@ -292,6 +297,16 @@ public:
             return "av_packet_clone";
         case CmdTag::APCP:
             return "av_packet_copy_props";
+        case CmdTag::ANP:
+            return "av_new_packet";
+        case CmdTag::ASFR:
+            return "avcodec_send_frame";
+        case CmdTag::AAFA:
+            return "av_audio_fifo_alloc";
+        case CmdTag::AAFW:
+            return "av_audio_fifo_write";
+        case CmdTag::APCO:
+            return "avcodec_parameters_copy";
         case CmdTag::SGC:
             return "sws_getContext";
         case CmdTag::AFIF:
@@ -0,0 +1,173 @@
+/********************************************************************
+* libavio/include/Exporter.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef EXPORTER_HPP
+#define EXPORTER_HPP
+
+#include <atomic>
+#include <thread>
+#include <functional>
+
+#include "Packet.hpp"
+#include "Reader.hpp"
+#include "Writer.hpp"
+
+namespace avio {
+
+// Copies the packets of a file between two points in time into a new file without decoding. Reading starts
+// at the key frame preceding the start time, so the clip may begin slightly early, and timestamps are rebased
+// to zero by the writer. Each exporter is independent, any number of them can run at the same time and with
+// async_io they share the disk thread used by the recorders.
+
+class Exporter {
+public:
+    std::string source;
+    std::string filename;           // without extension, the writer chooses one to suit the codecs
+    int64_t start_ms;               // on the timeline of the source file, in milliseconds
+    int64_t end_ms;
+    bool async_io = false;
+    bool disable_video = false;
+    bool disable_audio = false;
+
+    Reader* reader = nullptr;
+    Writer* writer = nullptr;
+    std::atomic<bool> cancelled { false };
+    bool running = false;
+    bool started = false;           // the first key frame has been found
+    bool video_done = false;
+    bool audio_done = false;
+    int64_t first_time = -1;
+    int64_t packets = 0;
+
+    std::function<void(float pct, const std::string& filename)> progressCallback = nullptr;
+    std::function<void(const std::string& filename)> exportFinished = nullptr;
+    std::function<void(const std::string& msg, const std::string& filename)> errorCallback = nullptr;
+
+    Exporter(const std::string& source, const std::string& filename, int64_t start_ms, int64_t end_ms)
+        : source(source), filename(filename), start_ms(start_ms), end_ms(end_ms) { }
+
+    ~Exporter() {
+        cleanup();
+    }
+
+    void start() {
+        std::thread thread([&]() { run(); });
+        thread.detach();
+    }
+
+    void cancel() {
+        cancelled = true;
+    }
+
+    // blocks until the clip is written, the result is false if it failed or was cancelled
+    bool run() {
+        running = true;
+        bool result = false;
+        try {
+            reader = new Reader(source);
+            reader->live_stream = false;
+            reader->disable_video = disable_video;
+            reader->disable_audio = disable_audio;
+            reader->infoCallback = [](const std::string& msg, const std::string& uri) { std::cout << uri << " " << msg << std::endl; };
+            if (disable_video) reader->video_stream_index = -1;
+            if (disable_audio) reader->audio_stream_index = -1;
+            if (!reader->has_video() && !reader->has_audio())
+                throw std::runtime_error("source has no streams to export");
+            video_done = !reader->has_video();
+            audio_done = !reader->has_audio();
+
+            int seek_index = reader->has_video() ? reader->video_stream_index : reader->audio_stream_index;
+            int64_t seek_pts = reader->pts_from_real_time(seek_index, start_ms);
+            if (start_ms > 0 && seek_pts != AV_NOPTS_VALUE)
+                av_seek_frame(reader->fmt_ctx, seek_index, seek_pts, AVSEEK_FLAG_BACKWARD);
+
+            writer = new Writer(reader);
+            writer->primary = false;
+            writer->disable_video = disable_video;
+            writer->disable_audio = disable_audio;
+            writer->async_io = async_io;
+            writer->open(filename);
+
+            reader->pkt_handle = [&](Packet&& pkt) { handle(pkt); };
+            while (!cancelled && !(video_done && audio_done) && reader->read()) {}
+
+            writer->close();
+            result = !cancelled && packets > 0;
+            if (!cancelled && !packets)
+                throw std::runtime_error("no packets found in the requested time range");
+            if (result) {
+                if (progressCallback) progressCallback(1.0f, writer->filename);
+                if (exportFinished) exportFinished(writer->filename);
+            }
+        }
+        catch (const std::exception& e) {
+            std::stringstream str;
+            str << "export of " << source << " failed: " << e.what();
+            std::cout << str.str() << std::endl;
+            if (errorCallback) errorCallback(str.str(), filename);
+        }
+        cleanup();
+        running = false;
+        return result;
+    }
+
+    void handle(Packet& pkt) {
+        if (pkt.is_null()) {
+            video_done = audio_done = true;
+            return;
+        }
+        bool video = pkt.stream_index() == reader->video_stream_index;
+        bool audio = pkt.stream_index() == reader->audio_stream_index;
+        if (!video && !audio) return;
+
+        int64_t time = reader->real_time(pkt.stream_index(), pkt.pts());
+        if (time > end_ms) {
+            if (video) video_done = true;
+            if (audio) audio_done = true;
+            return;
+        }
+
+        if (!started) {
+            // the clip opens on a key frame, audio from before it would have no picture to go with
+            if (reader->has_video() && !(video && pkt.is_key_frame()))
+                return;
+            started = true;
+            first_time = time;
+        }
+        else if (audio && time < first_time) {
+            return;
+        }
+
+        writer->write_packet(pkt.pkt);
+        packets++;
+        if (progressCallback && video && pkt.is_key_frame() && end_ms > first_time)
+            progressCallback((float)(time - first_time) / (end_ms - first_time), writer->filename);
+    }
+
+    void cleanup() {
+        if (writer) { delete writer; writer = nullptr; }
+        if (reader) { delete reader; reader = nullptr; }
+    }
+
+    bool isRunning() const { return running; }
+};
+
+}
+
+#endif // EXPORTER_HPP
@@ -0,0 +1,126 @@
+/********************************************************************
+* libavio/include/Fanout.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef FANOUT_HPP
+#define FANOUT_HPP
+
+#include <map>
+#include <mutex>
+
+#include "Packet.hpp"
+#include "Queue.hpp"
+#include "Reader.hpp"
+#include "Writer.hpp"
+#include "Segmenter.hpp"
+#include "Restreamer.hpp"
+
+namespace avio {
+
+// Feeds the packets of one stream to the primary writer and any number of named outputs, such as a
+// continuous archive alongside event clips. Every output keeps its own pre-record cache and recording
+// switch, the packet data is shared between them by reference.
+
+class Fanout {
+public:
+    Reader* reader = nullptr;
+    Writer* primary = nullptr;
+    Queue<Packet>* input = nullptr;
+    std::map<std::string, Writer*> outputs;
+    Segmenter* segmenter = nullptr;     // live playlist, not owned by the fanout
+    Restreamer* restreamer = nullptr;   // not owned either
+    std::mutex mutex;
+
+    Fanout(Reader* reader, Writer* primary) : reader(reader), primary(primary) { }
+
+    ~Fanout() {
+        for (auto& output : outputs)
+            delete output.second;
+    }
+
+    int write() {
+        return write(input->pop());
+    }
+
+    int write(Packet&& pkt) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& output : outputs)
+            output.second->write(pkt, true);
+        if (segmenter)
+            segmenter->write(pkt);
+        if (restreamer)
+            restreamer->write(pkt);
+        return primary->write(std::move(pkt));
+    }
+
+    // the new output copies the primary writer's file settings
+    Writer* add(const std::string& name, int cache_size_in_seconds) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (outputs.count(name))
+            return outputs[name];
+        Writer* writer = new Writer(reader);
+        writer->primary = false;
+        writer->cache_size_in_seconds = cache_size_in_seconds;
+        writer->disable_video = primary->disable_video;
+        writer->disable_audio = primary->disable_audio;
+        writer->async_io = primary->async_io;
+        writer->fragmented = primary->fragmented;
+        writer->segment_duration_in_seconds = primary->segment_duration_in_seconds;
+        writer->catalog = primary->catalog;
+        writer->video_encoder = primary->video_encoder;
+        writer->audio_encoder = primary->audio_encoder;
+        outputs[name] = writer;
+        return writer;
+    }
+
+    void remove(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = outputs.find(name);
+        if (it != outputs.end()) {
+            delete it->second;
+            outputs.erase(it);
+        }
+    }
+
+    bool start(const std::string& name, const std::string& filename) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = outputs.find(name);
+        if (it == outputs.end())
+            return false;
+        it->second->filename = filename;
+        it->second->recording = true;
+        return true;
+    }
+
+    void stop(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = outputs.find(name);
+        if (it != outputs.end())
+            it->second->recording = false;
+    }
+
+    bool is_recording(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = outputs.find(name);
+        return (it != outputs.end()) ? it->second->recording : false;
+    }
+};
+
+}
+
+#endif // FANOUT_HPP
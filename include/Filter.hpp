@@ -22,6 +22,8 @@
 
 #include <iostream>
 #include <sstream>
+#include <functional>
+#include <atomic>
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -51,6 +53,17 @@ public:
 	std::string description;
     ExceptionChecker ex;
 
+    // a suspended filter consumes its input without producing output, a secondary filter shares
+    // its output queue with another filter and so must never close it with a null frame
+    std::atomic<bool> suspended { false };
+    bool secondary = false;
+
+    // transcode mode, a copy of every filtered frame goes to the encoder, which keeps the filter
+    // running while it is suspended
+    Queue<Frame>* writer_frames = nullptr;
+    bool started = false;
+    std::function<void()> first_frame_callback = nullptr;
+
     Filter(Decoder* decoder, const std::string& description, Queue<Frame>* input, Queue<Frame>* output) 
             : decoder(decoder), description(description), input(input), output(output) {
 
@@ -104,25 +117,51 @@ public:
         Frame f = input->pop();
 
         if (decoder->reader->terminated) {
-            output->clear();
-            output->push(Frame(nullptr));
+            if (!secondary) {
+                output->clear();
+                output->push(Frame(nullptr));
+            }
+            if (writer_frames) {
+                writer_frames->clear();
+                writer_frames->push(Frame(nullptr));
+            }
             return 0;
         }
 
         if (f.is_null()) {
-            output->push(Frame(nullptr));
+            if (!secondary)
+                output->push(Frame(nullptr));
+            if (writer_frames)
+                writer_frames->push(Frame(nullptr));
             return 0; 
         }
 
         if (decoder->reader->seek_pts != AV_NOPTS_VALUE)
             return 1;
 
+        if (suspended && !writer_frames)
+            return 1;
+
+        if (!writer_frames && late(f)) {
+            // the frame would miss its slot on screen, skip the conversion work
+            decoder->reader->clock.dropped++;
+            return 1;
+        }
+
         try {
             ex.ck(av_buffersrc_add_frame_flags(src_ctx, f.frame, AV_BUFFERSRC_FLAG_KEEP_REF), ABAFF);
 
             int ret = -1;
             while ((ret = av_buffersink_get_frame(sink_ctx, av_frame)) >= 0) {
-                output->push(Frame(av_frame));
+                if (!started) {
+                    started = true;
+                    if (first_frame_callback) first_frame_callback();
+                }
+                Frame out(av_frame);
+                if (writer_frames)
+                    writer_frames->push(Frame(out));
+                if (!suspended)
+                    output->push(std::move(out));
             }
             if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
                 ex.ck(ret, "error during filtering");
@@ -136,6 +175,15 @@ public:
         return 1;
     }
 
+    bool late(const Frame& f) const {
+        Reader* reader = decoder->reader;
+        if (decoder->media_type != AVMEDIA_TYPE_VIDEO)
+            return false;
+        if (reader->live_stream && !reader->is_timeshifting() && !reader->drop_late_live)
+            return false;
+        return reader->clock.late(reader->real_time(decoder->stream_index, f.pts()));
+    }
+
     std::string get_input_config(Decoder* decoder) const {
         char args[512] = {0};
         AVRational time_base = decoder->reader->fmt_ctx->streams[decoder->stream_index]->time_base;
@@ -0,0 +1,130 @@
+/********************************************************************
+* libavio/include/FrameExtractor.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef FRAMEEXTRACTOR_HPP
+#define FRAMEEXTRACTOR_HPP
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+#include "Frame.hpp"
+#include "FrameReader.hpp"
+
+namespace avio {
+
+// Returns the frames on screen at a list of times in a file, for thumbnails and stills. The requests are
+// visited in time order. For each one the extractor either decodes forward from where it is, when there
+// is no key frame between the current position and the target, or seeks to the key frame before the
+// target, whichever decodes less. Only the frames that are returned go through the filter.
+
+class FrameExtractor {
+public:
+    FrameReader reader;
+    int64_t max_forward = 5000;         // milliseconds decoded forward rather than seeking when the file has no index
+    int64_t seeks = 0;
+    int64_t decoded = 0;
+
+    Frame previous { nullptr };         // last frame decoded at or before the current target
+    Frame pending { nullptr };          // first frame decoded after it
+    bool positioned = false;
+    bool eof = false;
+
+    FrameExtractor(const std::string& uri, const std::string& filter_description = "format=rgb24", const std::string& hw_device_type = "")
+        : reader(uri, filter_description, hw_device_type) { }
+
+    // times in milliseconds, the result is in the order asked for with a null frame where nothing was found
+    std::vector<Frame> extract(const std::vector<int64_t>& times) {
+        std::vector<size_t> order(times.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return times[a] < times[b]; });
+
+        std::vector<Frame> result;
+        result.reserve(times.size());
+        for (size_t i = 0; i < times.size(); i++)
+            result.emplace_back(nullptr);
+
+        for (size_t i : order) {
+            try {
+                Frame f = at(times[i]);
+                if (!f.is_null())
+                    result[i] = reader.apply_filter(std::move(f));
+            }
+            catch (const std::exception& e) {
+                std::cout << reader.uri << " frame extractor error at " << times[i] << " : " << e.what() << std::endl;
+            }
+        }
+        return result;
+    }
+
+    Frame at(int64_t time) {
+        if (should_seek(time)) {
+            reader.seek(time);
+            seeks++;
+            previous = Frame(nullptr);
+            pending = Frame(nullptr);
+            positioned = true;
+            eof = false;
+        }
+
+        while (!eof) {
+            if (!pending.is_null()) {
+                if (reader.time(pending) > time)
+                    break;
+                previous = std::move(pending);
+                pending = Frame(nullptr);
+            }
+            pending = reader.decode();
+            if (pending.is_null())
+                eof = true;
+            else
+                decoded++;
+        }
+
+        // a time before the first frame gets the first frame
+        if (!previous.is_null()) return previous;
+        if (!pending.is_null()) return pending;
+        return Frame(nullptr);
+    }
+
+    // decoding forward is cheaper unless there is a key frame between the position and the target
+    bool should_seek(int64_t time) {
+        if (!positioned)
+            return true;
+        const Frame& last = pending.is_null() ? previous : pending;
+        if (last.is_null())
+            return true;
+        int64_t position = reader.time(last);
+        if (time < (previous.is_null() ? position : reader.time(previous)))
+            return true;
+        if (time <= position || eof)
+            return false;
+
+        AVStream* stream = reader.reader->fmt_ctx->streams[reader.reader->video_stream_index];
+        int64_t pts = reader.reader->pts_from_real_time(stream->index, time);
+        int64_t key = key_frame_before_compat(stream, pts);
+        if (key == AV_NOPTS_VALUE)
+            return time - position > max_forward;
+        return reader.reader->real_time(stream->index, key) > position;
+    }
+};
+
+}
+
+#endif // FRAMEEXTRACTOR_HPP
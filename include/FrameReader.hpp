@@ -0,0 +1,152 @@
+/********************************************************************
+* libavio/include/FrameReader.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef FRAMEREADER_HPP
+#define FRAMEREADER_HPP
+
+#include "Packet.hpp"
+#include "Frame.hpp"
+#include "Queue.hpp"
+#include "Reader.hpp"
+#include "Decoder.hpp"
+#include "Filter.hpp"
+
+namespace avio {
+
+// Decodes the video of a file on the calling thread, one frame per call, for batch processing where the
+// frames are wanted as fast as they can be made. The reader, decoder and filter of the player are driven
+// directly, each stage is only run when the stage after it has run dry, so the unbounded queues between
+// them never hold more than the output of one packet. There is no pacing, display or audio.
+
+class FrameReader {
+public:
+    std::string uri;
+    Reader* reader = nullptr;
+    Decoder* decoder = nullptr;
+    Filter* filter = nullptr;
+    Queue<Packet> pkts;
+    Queue<Frame> decoded;
+    Queue<Frame> filtered;
+    bool done = false;
+    int64_t count = 0;
+    ExceptionChecker ex;
+
+    FrameReader(const std::string& uri, const std::string& filter_description = "format=rgb24", const std::string& hw_device_type = "")
+            : uri(uri) {
+        try {
+            reader = new Reader(uri);
+            reader->live_stream = false;
+            reader->disable_audio = true;
+            reader->infoCallback = [](const std::string& msg, const std::string& uri) { std::cout << uri << " " << msg << std::endl; };
+            if (!reader->has_video())
+                throw std::runtime_error("no video stream found");
+            reader->video_pkts = &pkts;
+
+            AVHWDeviceType type = AV_HWDEVICE_TYPE_NONE;
+            if (!hw_device_type.empty())
+                type = av_hwdevice_find_type_by_name(hw_device_type.c_str());
+            decoder = new Decoder(reader, AVMEDIA_TYPE_VIDEO, &pkts, &decoded, type);
+            filter = new Filter(decoder, filter_description, &decoded, &filtered);
+        }
+        catch (const std::exception& e) {
+            cleanup();
+            std::stringstream str;
+            str << uri << " frame reader error: " << e.what();
+            throw std::runtime_error(str.str());
+        }
+    }
+
+    ~FrameReader() {
+        cleanup();
+    }
+
+    void cleanup() {
+        if (filter)  { delete filter;  filter  = nullptr; }
+        if (decoder) { delete decoder; decoder = nullptr; }
+        if (reader)  { delete reader;  reader  = nullptr; }
+    }
+
+    // returns a null frame once the file is exhausted
+    Frame next() {
+        while (!done) {
+            if (filtered.size()) {
+                Frame f = filtered.pop();
+                if (f.is_null())
+                    break;
+                count++;
+                return f;
+            }
+            Frame f = decode();
+            if (f.is_null())
+                break;
+            decoded.push(std::move(f));
+            filter->filter();
+        }
+        done = true;
+        return Frame(nullptr);
+    }
+
+    // the next decoded frame before filtering, null at the end of the file
+    Frame decode() {
+        while (true) {
+            if (decoded.size())
+                return decoded.pop();
+            if (pkts.size())
+                decoder->decode();
+            else if (!reader->closed)
+                reader->read();
+            else
+                return Frame(nullptr);
+        }
+    }
+
+    // runs a single decoded frame through the filter, the result is null if the filter is holding it back
+    Frame apply_filter(Frame&& f) {
+        decoded.push(std::move(f));
+        filter->filter();
+        return filtered.size() ? filtered.pop() : Frame(nullptr);
+    }
+
+    // Repositions at the key frame at or before time in milliseconds. Decoding carries on from there, so
+    // the first frames returned may be earlier than the time asked for.
+    void seek(int64_t time) {
+        int64_t pts = reader->pts_from_real_time(reader->video_stream_index, time);
+        ex.ck(av_seek_frame(reader->fmt_ctx, reader->video_stream_index, pts, AVSEEK_FLAG_BACKWARD), ASF);
+        avcodec_flush_buffers(decoder->codec_ctx);
+        pkts.clear();
+        decoded.clear();
+        filtered.clear();
+        reader->closed = false;
+        done = false;
+    }
+
+    // stream time of a frame in milliseconds
+    int64_t time(const Frame& f) const {
+        return reader->real_time(reader->video_stream_index, f.pts());
+    }
+
+    int     width()    const { return reader->width(); }
+    int     height()   const { return reader->height(); }
+    double  fps()      const { return reader->fps(); }
+    int64_t duration() const { return reader->duration(); }
+};
+
+}
+
+#endif // FRAMEREADER_HPP
@@ -0,0 +1,225 @@
+/********************************************************************
+* libavio/include/HealthMonitor.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef HEALTHMONITOR_HPP
+#define HEALTHMONITOR_HPP
+
+#include <cmath>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <functional>
+#include <algorithm>
+
+#include "Luma.hpp"
+
+namespace avio {
+
+// A change in the condition of the picture. Black and frozen report when they begin and when they end,
+// a scene change is a single event.
+struct HealthEvent {
+    int64_t time = -1;                  // stream time in milliseconds
+    std::string type;                   // "black", "frozen" or "scene_change"
+    bool start = true;
+    float value = 0;                    // dark share, mean difference or histogram distance
+    int64_t duration = 0;               // milliseconds, when a condition ends
+};
+
+// the latest sample
+struct Health {
+    int64_t time = -1;
+    float mean = 0;                     // average luma
+    float dark = 0;                     // share of the pixels at or below the black threshold
+    float difference = 0;               // mean absolute luma difference from the previous sample
+    float scene = 0;                    // histogram distance from the previous sample, 0 to 1
+    bool black = false;
+    bool frozen = false;
+    int64_t scene_changes = 0;
+};
+
+// Checks that a camera is still showing something useful from a small grey scale copy of the decoded
+// frames, a few times a second. A picture that is nearly all dark for black_min_ms is black, one that
+// hasn't changed by more than freeze_threshold for freeze_min_ms is frozen. A camera that is moved or
+// covered changes both the brightness distribution and the layout of the picture at once, so a scene
+// change needs the histogram distance and the difference hash distance from the previous sample to be
+// over their thresholds together. Movement in front of the camera changes the layout but not much of
+// the histogram, lights going on change the histogram but not the layout.
+
+class HealthMonitor {
+public:
+    std::string uri;
+    int interval_ms = 500;
+    int black_threshold = 32;           // luma at or below which a pixel is dark
+    float black_ratio = 0.98f;
+    int black_min_ms = 2000;
+    float freeze_threshold = 0.5f;
+    int freeze_min_ms = 5000;
+    float scene_threshold = 0.35f;
+    int hash_threshold = 16;            // bits out of 64
+    std::function<void(const HealthEvent& event, const std::string& uri)> healthCallback = nullptr;
+
+    LumaSampler sampler;
+    LumaImage image;
+    LumaImage previous;
+    uint64_t previous_hash = 0;
+    float previous_bins[32] = {};
+    uint32_t histogram[256];
+    int64_t last_sample = -1;
+    int64_t dark_since = -1;
+    int64_t still_since = -1;
+    int64_t black_start = -1;
+    int64_t frozen_start = -1;
+    Health health;
+    std::vector<HealthEvent> events;
+    std::mutex mutex;
+
+    HealthMonitor(const std::string& uri) : uri(uri) {
+        sampler.max_width = 128;
+    }
+
+    void frame(const AVFrame* frame, int64_t time) {
+        if (time >= 0 && last_sample >= 0 && time >= last_sample && time - last_sample < interval_ms)
+            return;
+        if (time >= 0 && last_sample >= 0 && time < last_sample)
+            // the stream went back, the previous sample is not the one before this
+            previous.data.clear();
+        last_sample = time;
+        try {
+            sampler.sample(frame, image);
+            image.time = time;
+            check();
+            if (healthCallback) {
+                for (const HealthEvent& event : events)
+                    healthCallback(event, uri);
+            }
+            events.clear();
+        }
+        catch (const std::exception& e) {
+            std::cout << "health monitor error: " << e.what() << std::endl;
+        }
+    }
+
+    void check() {
+        size_t size = image.data.size();
+        if (!size)
+            return;
+        int64_t time = image.time;
+
+        histogram_u8(image.data.data(), size, histogram);
+        uint64_t sum = 0;
+        uint64_t dark = 0;
+        float bins[32] = {};
+        for (int b = 0; b < 256; b++) {
+            sum += (uint64_t)b * histogram[b];
+            if (b <= black_threshold) dark += histogram[b];
+            bins[b >> 3] += histogram[b];
+        }
+        for (float& bin : bins)
+            bin /= size;
+        uint64_t hash = difference_hash(image);
+
+        Health h;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            h = health;
+        }
+        h.time = time;
+        h.mean = (float)sum / size;
+        h.dark = (float)dark / size;
+
+        // black
+        if (h.dark >= black_ratio) {
+            if (dark_since < 0) dark_since = time;
+            if (!h.black && time - dark_since >= black_min_ms) {
+                h.black = true;
+                black_start = dark_since;
+                emit("black", true, h.dark, 0, time);
+            }
+        }
+        else {
+            dark_since = -1;
+            if (h.black) {
+                h.black = false;
+                emit("black", false, h.dark, time - black_start, time);
+            }
+        }
+
+        bool comparable = previous.data.size() == size && previous.width == image.width;
+        if (comparable) {
+            h.difference = (float)sad_u8(image.data.data(), previous.data.data(), size) / size;
+            float distance = 0;
+            for (int b = 0; b < 32; b++)
+                distance += std::fabs(bins[b] - previous_bins[b]);
+            h.scene = distance / 2;
+
+            // frozen, a black picture is also still, it is reported as black only
+            if (h.difference <= freeze_threshold && !h.black) {
+                if (still_since < 0) still_since = previous.time;
+                if (!h.frozen && time - still_since >= freeze_min_ms) {
+                    h.frozen = true;
+                    frozen_start = still_since;
+                    emit("frozen", true, h.difference, 0, time);
+                }
+            }
+            else {
+                still_since = -1;
+                if (h.frozen) {
+                    h.frozen = false;
+                    emit("frozen", false, h.difference, time - frozen_start, time);
+                }
+            }
+
+            if (h.scene >= scene_threshold && hamming_distance(hash, previous_hash) >= hash_threshold) {
+                h.scene_changes++;
+                emit("scene_change", true, h.scene, 0, time);
+            }
+        }
+        else {
+            h.difference = 0;
+            h.scene = 0;
+            still_since = -1;
+        }
+
+        std::swap(previous, image);
+        previous_hash = hash;
+        std::copy(bins, bins + 32, previous_bins);
+        std::lock_guard<std::mutex> lock(mutex);
+        health = h;
+    }
+
+    void emit(const char* type, bool start, float value, int64_t duration, int64_t time) {
+        HealthEvent event;
+        event.time = time;
+        event.type = type;
+        event.start = start;
+        event.value = value;
+        event.duration = duration;
+        events.push_back(event);
+    }
+
+    Health current() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return health;
+    }
+};
+
+}
+
+#endif // HEALTHMONITOR_HPP
@@ -0,0 +1,197 @@
+/********************************************************************
+* libavio/include/HttpServer.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef HTTPSERVER_HPP
+#define HTTPSERVER_HPP
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include "Socket.hpp"
+#include "Segmenter.hpp"
+
+namespace avio {
+
+// A minimal HTTP server for trying out the playlists of a Segmenter in a browser, it is not meant to face
+// the network. Requests are answered one at a time on a single thread, each connection is closed after
+// its response. Files come from the in memory store of the segmenter or its directory.
+
+class HttpServer {
+public:
+    Segmenter* segmenter = nullptr;
+    int port = 8080;
+    std::string address = "127.0.0.1";
+    socket_t listener = AVIO_INVALID_SOCKET;
+    std::atomic<bool> running { false };
+    std::thread* thread = nullptr;
+
+    HttpServer(Segmenter* segmenter, int port) : segmenter(segmenter), port(port) { }
+
+    ~HttpServer() {
+        stop();
+    }
+
+    void start() {
+        socket_startup();
+        try {
+            listener = listen_socket(address, port);
+        }
+        catch (const std::exception& e) {
+            socket_cleanup();
+            throw std::runtime_error(std::string("http server ") + e.what());
+        }
+        running = true;
+        thread = new std::thread([this] { while (serve()) {} });
+    }
+
+    void stop() {
+        if (!thread) return;
+        running = false;
+        // unblocks accept
+        shutdown_socket(listener);
+        avio_close_socket(listener);
+        listener = AVIO_INVALID_SOCKET;
+        thread->join();
+        delete thread;
+        thread = nullptr;
+        socket_cleanup();
+    }
+
+    std::string url() const {
+        return "http://" + address + ":" + std::to_string(port) + "/" + segmenter->playlist();
+    }
+
+    int serve() {
+        socket_t client = accept(listener, nullptr, nullptr);
+        if (!running)
+            return 0;
+        if (client == AVIO_INVALID_SOCKET)
+            return 1;
+
+        set_socket_timeout(client, SO_RCVTIMEO, 2000);
+        set_no_sigpipe(client);
+
+        try {
+            respond(client, read_request(client));
+        }
+        catch (const std::exception& e) {
+            std::cout << "http server error: " << e.what() << std::endl;
+        }
+        avio_close_socket(client);
+        return 1;
+    }
+
+    // the request line and headers, the body of a GET is empty
+    std::string read_request(socket_t client) {
+        std::string request;
+        char buf[2048];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < 16384) {
+            int n = recv(client, buf, sizeof(buf), 0);
+            if (n <= 0) break;
+            request.append(buf, n);
+        }
+        return request;
+    }
+
+    void respond(socket_t client, const std::string& request) {
+        std::istringstream line(request.substr(0, request.find("\r\n")));
+        std::string method, path;
+        line >> method >> path;
+
+        if (method == "OPTIONS") {
+            send_all(client, header(204, "", 0));
+            return;
+        }
+        if (method != "GET" && method != "HEAD") {
+            send_all(client, header(405, "", 0));
+            return;
+        }
+
+        path = path.substr(0, path.find('?'));
+        std::string name = path.size() > 1 ? path.substr(1) : segmenter->playlist();
+        if (name.find("..") != std::string::npos || name.find('/') != std::string::npos) {
+            send_all(client, header(404, "", 0));
+            return;
+        }
+
+        std::string body;
+        if (!find(name, body)) {
+            send_all(client, header(404, "", 0));
+            return;
+        }
+        send_all(client, header(200, content_type(name), body.size()));
+        if (method == "GET")
+            send_all(client, body);
+    }
+
+    bool find(const std::string& name, std::string& body) {
+        if (segmenter->in_memory()) {
+            std::shared_ptr<const std::string> file = segmenter->store.get(name);
+            if (!file) return false;
+            body = *file;
+            return true;
+        }
+        std::ifstream file(segmenter->directory + "/" + name, std::ios::binary);
+        if (!file) return false;
+        std::stringstream str;
+        str << file.rdbuf();
+        body = str.str();
+        return true;
+    }
+
+    static std::string header(int status, const std::string& type, size_t length) {
+        const char* reason = status == 200 ? "OK" : status == 204 ? "No Content" : status == 404 ? "Not Found" : "Method Not Allowed";
+        std::stringstream str;
+        str << "HTTP/1.1 " << status << " " << reason << "\r\n";
+        if (type.size())
+            str << "Content-Type: " << type << "\r\n";
+        str << "Content-Length: " << length << "\r\n";
+        // playlists change with every segment
+        str << "Cache-Control: no-cache\r\n";
+        str << "Access-Control-Allow-Origin: *\r\n";
+        str << "Access-Control-Allow-Methods: GET, HEAD, OPTIONS\r\n";
+        str << "Connection: close\r\n\r\n";
+        return str.str();
+    }
+
+    static std::string content_type(const std::string& name) {
+        size_t dot = name.rfind('.');
+        std::string ext = dot == std::string::npos ? "" : name.substr(dot);
+        if (ext == ".m3u8") return "application/vnd.apple.mpegurl";
+        if (ext == ".mpd")  return "application/dash+xml";
+        if (ext == ".m4s")  return "video/iso.segment";
+        if (ext == ".mp4")  return "video/mp4";
+        if (ext == ".ts")   return "video/mp2t";
+        return "application/octet-stream";
+    }
+
+    static void send_all(socket_t client, const std::string& data) {
+        avio::send_all(client, data.data(), data.size());
+    }
+};
+
+}
+
+#endif // HTTPSERVER_HPP
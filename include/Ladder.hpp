@@ -0,0 +1,247 @@
+/********************************************************************
+* libavio/include/Ladder.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef LADDER_HPP
+#define LADDER_HPP
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+#include "Exception.hpp"
+#include "Packet.hpp"
+#include "Frame.hpp"
+#include "Queue.hpp"
+#include "Reader.hpp"
+#include "Encoder.hpp"
+#include "Writer.hpp"
+
+namespace avio {
+
+// Settings of one rung of the ladder
+struct Rendition {
+    std::string name;
+    int width = 0;
+    int height = 0;                     // zero keeps the aspect ratio of the source
+    int64_t bit_rate = 0;               // zero encodes at constant quality
+};
+
+// A rendition at run time, with its own encoder and writer, each on a thread of its own
+struct LadderStep {
+    Rendition settings;
+    int width = 0;
+    int height = 0;
+    Queue<Frame> frames { 8 };
+    Queue<Packet> pkts { 128 };
+    Encoder* encoder = nullptr;
+    Writer* writer = nullptr;
+    SwsContext* sws_ctx = nullptr;
+    AVBufferPool* pool = nullptr;
+    int buffer_size = 0;
+    Frame last { nullptr };             // the picture of the current frame, the source of the next step down
+    std::thread* encoder_thread = nullptr;
+    std::thread* writer_thread = nullptr;
+    std::atomic<bool> done { false };
+};
+
+// Makes several recordings of one live stream at different sizes from a single decode. The filtered
+// frames are scaled once per rendition, largest first, and each smaller picture is scaled from the one
+// above it rather than from the source, so the expensive pass over the full size frame happens once.
+// The scaled pictures come from a buffer pool per rendition and are handed to the encoders by reference.
+// Each rendition writer has its own recording switch and pre-record cache, like the outputs of the
+// fanout. Audio is not re-encoded, the packets of the source are shared by all the renditions.
+
+class Ladder {
+public:
+    Reader* reader = nullptr;
+    Queue<Frame>* input = nullptr;
+    Queue<Frame>* forward = nullptr;    // the source frames go on here, for the encoder of the primary writer
+    Queue<Packet> audio_pkts { 128 };
+    Queue<Packet>* forward_pkts = nullptr;
+    std::vector<LadderStep*> steps;
+    std::thread* scale_thread = nullptr;
+    std::thread* audio_thread = nullptr;
+    int scale_flags = SWS_BILINEAR;
+    ExceptionChecker ex;
+
+    Ladder(Reader* reader, const std::vector<Rendition>& renditions, Queue<Frame>* input, const std::string& codec_name,
+            const std::string& preset, int crf, int threads) : reader(reader), input(input) {
+        int src_width = reader->width();
+        int src_height = reader->height();
+        std::vector<std::pair<int, int>> sizes;
+        for (const Rendition& rendition : renditions) {
+            int width = rendition.width > 0 ? rendition.width : src_width;
+            int height = rendition.height > 0 ? rendition.height : (src_width > 0 ? (int)((int64_t)src_height * width / src_width) : src_height);
+            // yuv 4:2:0 needs even dimensions
+            width &= ~1;
+            height &= ~1;
+            if (width <= 0 || height <= 0)
+                throw std::runtime_error("rendition " + rendition.name + " has no size");
+            sizes.emplace_back(width, height);
+        }
+
+        for (size_t i = 0; i < renditions.size(); i++) {
+            const Rendition& rendition = renditions[i];
+            LadderStep* step = new LadderStep();
+            step->settings = rendition;
+            step->width = sizes[i].first;
+            step->height = sizes[i].second;
+            step->buffer_size = av_image_get_buffer_size(AV_PIX_FMT_YUV420P, step->width, step->height, 32);
+            ex.ck(step->pool = av_buffer_pool_init(step->buffer_size, nullptr));
+
+            step->encoder = new Encoder(reader, AVMEDIA_TYPE_VIDEO, &step->frames, &step->pkts, codec_name);
+            step->encoder->preset = preset;
+            step->encoder->crf = crf;
+            step->encoder->bit_rate = rendition.bit_rate;
+            step->encoder->threads = threads;
+
+            step->writer = new Writer(reader);
+            step->writer->primary = false;
+            step->writer->video_encoder = step->encoder;
+            steps.push_back(step);
+        }
+        std::stable_sort(steps.begin(), steps.end(), [](const LadderStep* a, const LadderStep* b) {
+            return (int64_t)a->width * a->height > (int64_t)b->width * b->height;
+        });
+    }
+
+    ~Ladder() {
+        for (LadderStep* step : steps) {
+            if (step->writer) delete step->writer;
+            if (step->encoder) delete step->encoder;
+            if (step->sws_ctx) sws_freeContext(step->sws_ctx);
+            step->last = Frame(nullptr);
+            if (step->pool) av_buffer_pool_uninit(&step->pool);
+            delete step;
+        }
+    }
+
+    void start(bool audio) {
+        for (LadderStep* step : steps) {
+            step->writer->disable_audio = !audio;
+            step->encoder_thread = new std::thread([step] { while (step->encoder->encode()) {} });
+            step->writer_thread = new std::thread([this, step] { write(step); });
+        }
+        scale_thread = new std::thread([this] { while (scale()) {} });
+        if (audio)
+            audio_thread = new std::thread([this] { while (route_audio()) {} });
+    }
+
+    void join() {
+        if (scale_thread) { scale_thread->join(); delete scale_thread; scale_thread = nullptr; }
+        if (audio_thread) { audio_thread->join(); delete audio_thread; audio_thread = nullptr; }
+        for (LadderStep* step : steps) {
+            if (step->encoder_thread) { step->encoder_thread->join(); delete step->encoder_thread; step->encoder_thread = nullptr; }
+            if (step->writer_thread)  { step->writer_thread->join();  delete step->writer_thread;  step->writer_thread  = nullptr; }
+        }
+    }
+
+    int scale() {
+        Frame f = input->pop();
+
+        if (f.is_null() || reader->terminated) {
+            if (forward) forward->push(Frame(nullptr));
+            for (LadderStep* step : steps) {
+                if (reader->terminated) step->frames.clear();
+                step->frames.push(Frame(nullptr));
+            }
+            return 0;
+        }
+
+        const Frame* src = &f;
+        for (LadderStep* step : steps) {
+            try {
+                step->last = resize(step, *src);
+                step->frames.push(Frame(step->last));
+                src = &step->last;
+            }
+            catch (const std::exception& e) {
+                std::cout << step->settings.name << " rendition scaling error: " << e.what() << std::endl;
+            }
+        }
+        if (forward)
+            forward->push(std::move(f));
+        return 1;
+    }
+
+    Frame resize(LadderStep* step, const Frame& src) {
+        if (src.width() == step->width && src.height() == step->height && src.format() == AV_PIX_FMT_YUV420P)
+            return Frame(src);
+
+        ex.ck(step->sws_ctx = sws_getCachedContext(step->sws_ctx, src.width(), src.height(), (AVPixelFormat)src.format(),
+                step->width, step->height, AV_PIX_FMT_YUV420P, scale_flags, nullptr, nullptr, nullptr), SGC);
+
+        AVFrame* out = av_frame_alloc();
+        ex.ck(out, AFA);
+        out->width = step->width;
+        out->height = step->height;
+        out->format = AV_PIX_FMT_YUV420P;
+        out->buf[0] = av_buffer_pool_get(step->pool);
+        if (!out->buf[0]) {
+            av_frame_free(&out);
+            throw std::runtime_error("rendition buffer allocation failure");
+        }
+        av_image_fill_arrays(out->data, out->linesize, out->buf[0]->data, AV_PIX_FMT_YUV420P, step->width, step->height, 32);
+        av_frame_copy_props(out, src.frame);
+        int ret = sws_scale(step->sws_ctx, src.frame->data, src.frame->linesize, 0, src.height(), out->data, out->linesize);
+        Frame result(out);
+        av_frame_free(&out);
+        ex.ck(ret, SS);
+        return result;
+    }
+
+    // The writer of a step stops at the null packet of its encoder. The queue is cleared on the way out so
+    // that the audio router can't be left waiting on it.
+    void write(LadderStep* step) {
+        while (step->writer->write(step->pkts.pop())) {}
+        step->done = true;
+        step->pkts.clear();
+    }
+
+    // the audio packets of the source go to every rendition, the end of the stream only goes on to the primary writer
+    int route_audio() {
+        Packet pkt = audio_pkts.pop();
+        bool end = pkt.is_null();
+        if (!end) {
+            for (LadderStep* step : steps)
+                if (!step->done) step->pkts.push(Packet(pkt));
+        }
+        if (forward_pkts)
+            forward_pkts->push(std::move(pkt));
+        return end ? 0 : 1;
+    }
+
+    LadderStep* find(const std::string& name) {
+        for (LadderStep* step : steps)
+            if (step->settings.name == name)
+                return step;
+        return nullptr;
+    }
+};
+
+}
+
+#endif // LADDER_HPP
@@ -0,0 +1,224 @@
+/********************************************************************
+* libavio/include/Luma.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef LUMA_HPP
+#define LUMA_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <bitset>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AVIO_LUMA_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define AVIO_LUMA_NEON
+#include <arm_neon.h>
+#endif
+
+#include "Exception.hpp"
+
+namespace avio {
+
+// A small grey scale copy of a video frame for the analysis stages, one byte per pixel without padding
+struct LumaImage {
+    int width = 0;
+    int height = 0;
+    int64_t time = -1;                  // stream time in milliseconds
+    std::vector<uint8_t> data;
+
+    const uint8_t* row(int y) const { return data.data() + (size_t)y * width; }
+};
+
+// Averages each 2x2 block of src into one pixel of dst, the width and height of dst are half those of src
+inline void halve_u8(const uint8_t* src, int src_stride, int width, int height, uint8_t* dst, int dst_stride) {
+    int out_w = width / 2;
+    int out_h = height / 2;
+    for (int y = 0; y < out_h; y++) {
+        const uint8_t* r0 = src + (size_t)2 * y * src_stride;
+        const uint8_t* r1 = r0 + src_stride;
+        uint8_t* d = dst + (size_t)y * dst_stride;
+        int x = 0;
+#if defined(AVIO_LUMA_SSE2)
+        const __m128i low = _mm_set1_epi16(0x00ff);
+        const __m128i one = _mm_set1_epi16(1);
+        for (; x + 16 <= out_w; x += 16) {
+            __m128i v0 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(r0 + 2 * x)), _mm_loadu_si128((const __m128i*)(r1 + 2 * x)));
+            __m128i v1 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(r0 + 2 * x + 16)), _mm_loadu_si128((const __m128i*)(r1 + 2 * x + 16)));
+            __m128i s0 = _mm_add_epi16(_mm_and_si128(v0, low), _mm_srli_epi16(v0, 8));
+            __m128i s1 = _mm_add_epi16(_mm_and_si128(v1, low), _mm_srli_epi16(v1, 8));
+            s0 = _mm_srli_epi16(_mm_add_epi16(s0, one), 1);
+            s1 = _mm_srli_epi16(_mm_add_epi16(s1, one), 1);
+            _mm_storeu_si128((__m128i*)(d + x), _mm_packus_epi16(s0, s1));
+        }
+#elif defined(AVIO_LUMA_NEON)
+        for (; x + 16 <= out_w; x += 16) {
+            uint8x16_t v0 = vrhaddq_u8(vld1q_u8(r0 + 2 * x), vld1q_u8(r1 + 2 * x));
+            uint8x16_t v1 = vrhaddq_u8(vld1q_u8(r0 + 2 * x + 16), vld1q_u8(r1 + 2 * x + 16));
+            vst1q_u8(d + x, vcombine_u8(vrshrn_n_u16(vpaddlq_u8(v0), 1), vrshrn_n_u16(vpaddlq_u8(v1), 1)));
+        }
+#endif
+        for (; x < out_w; x++)
+            d[x] = (uint8_t)((r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2) >> 2);
+    }
+}
+
+// sum of absolute differences of two equal sized images
+inline uint64_t sad_u8(const uint8_t* a, const uint8_t* b, size_t n) {
+    size_t i = 0;
+    uint64_t sum = 0;
+#if defined(AVIO_LUMA_SSE2)
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16)
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i))));
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    sum = lanes[0] + lanes[1];
+#elif defined(AVIO_LUMA_NEON)
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (; i + 16 <= n; i += 16)
+        acc = vpadalq_u16(acc, vpaddlq_u8(vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i))));
+    sum = vaddvq_u32(acc);
+#endif
+    for (; i < n; i++)
+        sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    return sum;
+}
+
+// 256 bin histogram, counted into four tables so that runs of equal pixels don't wait on each other
+inline void histogram_u8(const uint8_t* src, size_t n, uint32_t* bins) {
+    uint32_t tables[4][256] = {};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        tables[0][src[i]]++;
+        tables[1][src[i + 1]]++;
+        tables[2][src[i + 2]]++;
+        tables[3][src[i + 3]]++;
+    }
+    for (; i < n; i++)
+        tables[0][src[i]]++;
+    for (int b = 0; b < 256; b++)
+        bins[b] = tables[0][b] + tables[1][b] + tables[2][b] + tables[3][b];
+}
+
+// Difference hash of the layout of the picture, each bit says whether a cell of a 9x8 grid is brighter
+// than its neighbour on the right. Similar pictures differ in few bits whatever their exposure.
+inline uint64_t difference_hash(const LumaImage& image) {
+    if (image.width < 9 || image.height < 8)
+        return 0;
+    uint32_t cells[8][9] = {};
+    for (int y = 0; y < image.height; y++) {
+        const uint8_t* src = image.row(y);
+        uint32_t* row = cells[y * 8 / image.height];
+        for (int x = 0; x < image.width; x++)
+            row[x * 9 / image.width] += src[x];
+    }
+    // the cells of a column hold about the same number of pixels, so the sums compare like the means
+    uint64_t hash = 0;
+    for (int r = 0; r < 8; r++) {
+        for (int c = 0; c < 8; c++) {
+            int w0 = (c + 1) * image.width / 9 - c * image.width / 9;
+            int w1 = (c + 2) * image.width / 9 - (c + 1) * image.width / 9;
+            hash = (hash << 1) | ((uint64_t)cells[r][c] * w1 > (uint64_t)cells[r][c + 1] * w0);
+        }
+    }
+    return hash;
+}
+
+inline int hamming_distance(uint64_t a, uint64_t b) {
+    return (int)std::bitset<64>(a ^ b).count();
+}
+
+// Makes the LumaImage of a decoded frame. The Y plane of 8 bit yuv and nv12 frames is read in place and
+// halved until it fits in max_width, so the chroma is never touched and nothing full size is copied.
+// Other formats, such as rgb or high bit depth, go through swscale to the same size.
+
+class LumaSampler {
+public:
+    int max_width = 160;
+    SwsContext* sws_ctx = nullptr;
+    std::vector<uint8_t> scratch;
+    ExceptionChecker ex;
+
+    ~LumaSampler() {
+        if (sws_ctx) sws_freeContext(sws_ctx);
+    }
+
+    static bool has_luma_plane(int format) {
+        const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)format);
+        if (!desc || desc->nb_components < 1)
+            return false;
+        if (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))
+            return false;
+        return desc->comp[0].plane == 0 && desc->comp[0].step == 1 && desc->comp[0].depth == 8;
+    }
+
+    void sample(const AVFrame* frame, LumaImage& image) {
+        int width = frame->width;
+        int height = frame->height;
+        int shift = 0;
+        while ((width >> shift) > max_width && (width >> (shift + 1)) > 0 && (height >> (shift + 1)) > 0)
+            shift++;
+        image.width = width >> shift;
+        image.height = height >> shift;
+        image.data.resize((size_t)image.width * image.height);
+
+        if (!has_luma_plane(frame->format)) {
+            ex.ck(sws_ctx = sws_getCachedContext(sws_ctx, width, height, (AVPixelFormat)frame->format,
+                    image.width, image.height, AV_PIX_FMT_GRAY8, SWS_AREA, nullptr, nullptr, nullptr), SGC);
+            uint8_t* dst[4] = { image.data.data(), nullptr, nullptr, nullptr };
+            int dst_stride[4] = { image.width, 0, 0, 0 };
+            ex.ck(sws_scale(sws_ctx, frame->data, frame->linesize, 0, height, dst, dst_stride), SS);
+            return;
+        }
+
+        if (!shift) {
+            for (int y = 0; y < height; y++)
+                memcpy(image.data.data() + (size_t)y * width, frame->data[0] + (size_t)y * frame->linesize[0], width);
+            return;
+        }
+
+        // each pass halves the previous one, the last pass lands in the image
+        const uint8_t* src = frame->data[0];
+        int src_stride = frame->linesize[0];
+        scratch.resize((size_t)(width / 2) * (height / 2) * 2);
+        uint8_t* buffers[2] = { scratch.data(), scratch.data() + (size_t)(width / 2) * (height / 2) };
+        for (int pass = 0; pass < shift; pass++) {
+            int out_w = width >> 1;
+            int out_h = height >> 1;
+            uint8_t* dst = pass == shift - 1 ? image.data.data() : buffers[pass & 1];
+            halve_u8(src, src_stride, width, height, dst, out_w);
+            src = dst;
+            src_stride = out_w;
+            width = out_w;
+            height = out_h;
+        }
+    }
+};
+
+}
+
+#endif // LUMA_HPP
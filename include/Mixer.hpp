@@ -0,0 +1,239 @@
+/********************************************************************
+* libavio/include/Mixer.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef MIXER_HPP
+#define MIXER_HPP
+
+#include <SDL.h>
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AVIO_MIX_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define AVIO_MIX_NEON
+#include <arm_neon.h>
+#endif
+
+#include "AudioRing.hpp"
+#include "Reader.hpp"
+
+namespace avio {
+
+// Playback state of one audio stream as seen by the callback that plays it, either its own device or the mixer
+class AudioSource {
+public:
+    Reader* reader = nullptr;
+    AudioRing* ring = nullptr;
+    float volume = 1.0f;
+    bool mute = false;
+    std::atomic<bool> closed { false };
+    std::atomic<bool> draining { false };
+    std::atomic<bool> flush { false };
+    std::atomic<float> peak { 0.0f };   // loudest sample of the last buffer played, 0 to 1
+
+    AudioSource(Reader* reader) : reader(reader) { }
+};
+
+// Gain is in Q14 fixed point so that unity is exact and sources can be boosted up to 2x. Each source is
+// scaled and summed into a 32 bit accumulator, which is clamped back to 16 bits once all sources are in.
+
+inline int16_t gain_q14(float volume) {
+    return (int16_t)std::min(32767.0f, std::max(0.0f, volume * 16384.0f + 0.5f));
+}
+
+// adds src scaled by gain to acc, returning the peak absolute value of src
+inline int mix_s16(int32_t* acc, const int16_t* src, int n, int16_t gain) {
+    int i = 0;
+    int peak = 0;
+#if defined(AVIO_MIX_SSE2)
+    const __m128i g = _mm_set1_epi16(gain);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i vpeak = zero;
+    for (; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+        vpeak = _mm_max_epi16(vpeak, _mm_max_epi16(x, _mm_subs_epi16(zero, x)));
+        __m128i lo = _mm_mullo_epi16(x, g);
+        __m128i hi = _mm_mulhi_epi16(x, g);
+        __m128i p0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 14);
+        __m128i p1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 14);
+        __m128i* a = (__m128i*)(acc + i);
+        _mm_storeu_si128(a,     _mm_add_epi32(_mm_loadu_si128(a),     p0));
+        _mm_storeu_si128(a + 1, _mm_add_epi32(_mm_loadu_si128(a + 1), p1));
+    }
+    int16_t lanes[8];
+    _mm_storeu_si128((__m128i*)lanes, vpeak);
+    for (int k = 0; k < 8; k++) peak = std::max(peak, (int)lanes[k]);
+#elif defined(AVIO_MIX_NEON)
+    int16x8_t vpeak = vdupq_n_s16(0);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(src + i);
+        vpeak = vmaxq_s16(vpeak, vqabsq_s16(x));
+        int32x4_t p0 = vshrq_n_s32(vmull_n_s16(vget_low_s16(x), gain), 14);
+        int32x4_t p1 = vshrq_n_s32(vmull_n_s16(vget_high_s16(x), gain), 14);
+        vst1q_s32(acc + i,     vaddq_s32(vld1q_s32(acc + i),     p0));
+        vst1q_s32(acc + i + 4, vaddq_s32(vld1q_s32(acc + i + 4), p1));
+    }
+    peak = vmaxvq_s16(vpeak);
+#endif
+    for (; i < n; i++) {
+        int x = src[i];
+        peak = std::max(peak, std::abs(x));
+        acc[i] += (x * gain) >> 14;
+    }
+    return std::min(peak, 32767);
+}
+
+// clamps the accumulated mix to 16 bits
+inline void pack_s16(int16_t* dst, const int32_t* acc, int n) {
+    int i = 0;
+#if defined(AVIO_MIX_SSE2)
+    for (; i + 8 <= n; i += 8) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(acc + i));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(acc + i + 4));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(a0, a1));
+    }
+#elif defined(AVIO_MIX_NEON)
+    for (; i + 8 <= n; i += 8) {
+        int16x4_t lo = vqmovn_s32(vld1q_s32(acc + i));
+        int16x4_t hi = vqmovn_s32(vld1q_s32(acc + i + 4));
+        vst1q_s16(dst + i, vcombine_s16(lo, hi));
+    }
+#endif
+    for (; i < n; i++)
+        dst[i] = (int16_t)std::min(32767, std::max(-32768, acc[i]));
+}
+
+inline int peak_s16(const int16_t* src, int n) {
+    int peak = 0;
+    for (int i = 0; i < n; i++)
+        peak = std::max(peak, std::abs((int)src[i]));
+    return std::min(peak, 32767);
+}
+
+// One output device shared by any number of audio streams. Each stream resamples into its own ring at the
+// device format, the device callback sums them in a single pass. The mixer lives for the duration of the
+// process once opened, the device is paused whenever there is nothing to play.
+
+class Mixer {
+public:
+    SDL_AudioSpec sdl = { 0 };
+    SDL_AudioSpec have = { 0 };
+    SDL_AudioDeviceID device_id = 0;
+    std::vector<AudioSource*> sources;  // changed only while the device is locked
+    std::vector<int32_t> acc;
+    std::vector<int16_t> scratch;
+    std::mutex mutex;
+
+    static Mixer* instance() {
+        // intentionally never deleted, the device is shared by every player in the process
+        static Mixer* mixer = new Mixer();
+        return mixer;
+    }
+
+    void open(int audio_driver_index) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (device_id) return;
+
+        if (!SDL_WasInit(SDL_INIT_AUDIO)) {
+            SDL_SetHint("SDL_AUDIODRIVER", SDL_GetAudioDriver(audio_driver_index));
+            if (SDL_Init(SDL_INIT_AUDIO))
+                error("SDL audio init error");
+            std::cout << "Using SDL audio driver " << SDL_GetCurrentAudioDriver() << std::endl;
+        }
+
+        sdl.freq = 48000;
+        sdl.channels = 2;
+        sdl.format = AUDIO_S16SYS;
+        sdl.samples = 1024;
+        sdl.silence = 0;
+        sdl.callback = callback;
+        sdl.userdata = this;
+        if (!(device_id = SDL_OpenAudioDevice(NULL, 0, &sdl, &have, 0)))
+            error("SDL_OpenAudioDevice error");
+
+        size_t length = std::max((size_t)have.size / sizeof(int16_t), (size_t)have.samples * have.channels);
+        acc.resize(length);
+        scratch.resize(length);
+    }
+
+    void add(AudioSource* source) {
+        std::lock_guard<std::mutex> lock(mutex);
+        SDL_LockAudioDevice(device_id);
+        sources.push_back(source);
+        SDL_UnlockAudioDevice(device_id);
+        SDL_PauseAudioDevice(device_id, 0);
+    }
+
+    void remove(AudioSource* source) {
+        std::lock_guard<std::mutex> lock(mutex);
+        SDL_LockAudioDevice(device_id);
+        sources.erase(std::remove(sources.begin(), sources.end(), source), sources.end());
+        SDL_UnlockAudioDevice(device_id);
+        if (sources.empty())
+            SDL_PauseAudioDevice(device_id, 1);
+    }
+
+    static void callback(void* user_data, uint8_t* output_buffer, int output_length) {
+        ((Mixer*)user_data)->mix((int16_t*)output_buffer, output_length / sizeof(int16_t));
+    }
+
+    // runs on the SDL audio thread
+    void mix(int16_t* output, int length) {
+        for (int offset = 0; offset < length; offset += (int)acc.size()) {
+            int n = std::min(length - offset, (int)acc.size());
+            std::fill(acc.begin(), acc.begin() + n, 0);
+            for (AudioSource* source : sources) {
+                if (source->reader->terminated) {
+                    source->closed = true;
+                    continue;
+                }
+                if (source->flush) {
+                    source->ring->discard();
+                    source->flush = false;
+                }
+                if (source->reader->paused)
+                    continue;
+                int bytes = (int)source->ring->read((uint8_t*)scratch.data(), n * sizeof(int16_t));
+                if (bytes < n * (int)sizeof(int16_t) && source->draining)
+                    source->closed = true;
+                int16_t gain = source->mute ? 0 : gain_q14(source->volume);
+                int peak = mix_s16(acc.data(), scratch.data(), bytes / sizeof(int16_t), gain);
+                source->peak = peak / 32767.0f;
+            }
+            pack_s16(output + offset, acc.data(), n);
+        }
+    }
+
+    void error(const std::string& msg) {
+        std::stringstream str;
+        str << msg << " : " << SDL_GetError();
+        throw std::runtime_error(str.str());
+    }
+
+private:
+    Mixer() { }
+};
+
+}
+
+#endif // MIXER_HPP
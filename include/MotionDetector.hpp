@@ -0,0 +1,210 @@
+/********************************************************************
+* libavio/include/MotionDetector.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef MOTIONDETECTOR_HPP
+#define MOTIONDETECTOR_HPP
+
+#include <mutex>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <functional>
+#include <algorithm>
+
+#include "Luma.hpp"
+
+namespace avio {
+
+// A moving area in fractions of the picture size, level is the share of its pixels that moved
+struct MotionRegion {
+    float x = 0;
+    float y = 0;
+    float w = 0;
+    float h = 0;
+    float level = 0;
+};
+
+struct Motion {
+    int64_t time = -1;                  // stream time in milliseconds
+    float level = 0;                    // share of the whole picture in motion
+    bool motion = false;
+    std::vector<MotionRegion> regions;
+};
+
+// Pixel motion detection on a small grey scale copy of the decoded frames. It is handed the frames on the
+// decoder thread but only samples one every interval_ms, so it costs little more than the downscale.
+// Each sample is compared with a running average of the scene, the pixels that differ by more than the
+// threshold are counted per cell of a grid, and neighbouring cells with enough of them are joined into
+// regions. The background learns slowly where there is motion, so something that stops moving fades into
+// it rather than staying a region for good. A change over most of the picture is taken to be the lighting,
+// and the background starts again from the current sample.
+
+class MotionDetector {
+public:
+    std::string uri;
+    int interval_ms = 200;
+    int threshold = 20;                 // luma difference from the background of a moving pixel
+    float learning_rate = 0.05f;        // share of each sample taken into the background
+    int grid_cols = 16;
+    int grid_rows = 12;
+    float cell_threshold = 0.05f;       // share of moving pixels that makes a cell active
+    float lighting_level = 0.7f;
+    std::function<void(const Motion& motion, const std::string& uri)> motionCallback = nullptr;
+
+    LumaSampler sampler;
+    LumaImage image;
+    std::vector<uint16_t> background;   // 8.8 fixed point
+    std::vector<int> cell_count;
+    std::vector<int> cell_area;
+    std::vector<int> cell_label;
+    std::vector<int> stack;
+    int64_t last_sample = -1;
+    Motion last;
+    std::mutex mutex;
+
+    MotionDetector(const std::string& uri) : uri(uri) { }
+
+    void frame(const AVFrame* frame, int64_t time) {
+        if (time >= 0 && last_sample >= 0 && time >= last_sample && time - last_sample < interval_ms)
+            return;
+        last_sample = time;
+        try {
+            sampler.sample(frame, image);
+            image.time = time;
+            Motion motion = detect();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                last = motion;
+            }
+            if (motionCallback)
+                motionCallback(motion, uri);
+        }
+        catch (const std::exception& e) {
+            std::cout << "motion detector error: " << e.what() << std::endl;
+        }
+    }
+
+    Motion detect() {
+        Motion motion;
+        motion.time = image.time;
+        size_t size = image.data.size();
+        if (!size)
+            return motion;
+        if (background.size() != size) {
+            // first sample or a new resolution
+            reset();
+            return motion;
+        }
+
+        int cols = std::max(1, std::min(grid_cols, image.width));
+        int rows = std::max(1, std::min(grid_rows, image.height));
+        cell_count.assign((size_t)cols * rows, 0);
+        cell_area.assign((size_t)cols * rows, 0);
+        int fast = std::min(256, std::max(1, (int)(learning_rate * 256)));
+        int slow = std::max(1, fast / 8);
+        int moving = 0;
+
+        for (int y = 0; y < image.height; y++) {
+            const uint8_t* src = image.row(y);
+            uint16_t* bg = background.data() + (size_t)y * image.width;
+            int* counts = cell_count.data() + (size_t)(y * rows / image.height) * cols;
+            int* areas = cell_area.data() + (size_t)(y * rows / image.height) * cols;
+            for (int x = 0; x < image.width; x++) {
+                int diff = ((int)src[x] << 8) - bg[x];
+                bool fg = diff >= (threshold << 8) || diff <= -(threshold << 8);
+                int cell = x * cols / image.width;
+                counts[cell] += fg;
+                areas[cell]++;
+                moving += fg;
+                bg[x] = (uint16_t)(bg[x] + ((diff * (fg ? slow : fast)) >> 8));
+            }
+        }
+
+        motion.level = (float)moving / size;
+        if (motion.level >= lighting_level) {
+            reset();
+            motion.level = 0;
+            return motion;
+        }
+        regions(motion, cols, rows);
+        motion.motion = motion.regions.size() > 0;
+        return motion;
+    }
+
+    // joins the active cells that touch into regions
+    void regions(Motion& motion, int cols, int rows) {
+        cell_label.assign((size_t)cols * rows, -1);
+        for (int start = 0; start < cols * rows; start++) {
+            if (cell_label[start] >= 0 || !active(start))
+                continue;
+            int label = (int)motion.regions.size();
+            int min_c = cols, max_c = -1, min_r = rows, max_r = -1;
+            int count = 0, area = 0;
+            stack.clear();
+            stack.push_back(start);
+            cell_label[start] = label;
+            while (stack.size()) {
+                int cell = stack.back();
+                stack.pop_back();
+                int c = cell % cols;
+                int r = cell / cols;
+                min_c = std::min(min_c, c); max_c = std::max(max_c, c);
+                min_r = std::min(min_r, r); max_r = std::max(max_r, r);
+                count += cell_count[cell];
+                area += cell_area[cell];
+                const int next[4][2] = { { c - 1, r }, { c + 1, r }, { c, r - 1 }, { c, r + 1 } };
+                for (const auto& n : next) {
+                    if (n[0] < 0 || n[0] >= cols || n[1] < 0 || n[1] >= rows)
+                        continue;
+                    int neighbour = n[1] * cols + n[0];
+                    if (cell_label[neighbour] < 0 && active(neighbour)) {
+                        cell_label[neighbour] = label;
+                        stack.push_back(neighbour);
+                    }
+                }
+            }
+            MotionRegion region;
+            region.x = (float)min_c / cols;
+            region.y = (float)min_r / rows;
+            region.w = (float)(max_c - min_c + 1) / cols;
+            region.h = (float)(max_r - min_r + 1) / rows;
+            region.level = area ? (float)count / area : 0;
+            motion.regions.push_back(region);
+        }
+    }
+
+    bool active(int cell) const {
+        return cell_area[cell] && cell_count[cell] >= cell_threshold * cell_area[cell];
+    }
+
+    void reset() {
+        background.resize(image.data.size());
+        for (size_t i = 0; i < image.data.size(); i++)
+            background[i] = (uint16_t)(image.data[i] << 8);
+    }
+
+    Motion current() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return last;
+    }
+};
+
+}
+
+#endif // MOTIONDETECTOR_HPP
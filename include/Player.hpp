@@ -24,6 +24,8 @@
 
 #include <thread>
 #include <map>
+#include <mutex>
+#include <atomic>
 
 #include "Packet.hpp"
 #include "Frame.hpp"
@@ -35,6 +37,14 @@
 #include "Decoder.hpp"
 #include "Drain.hpp"
 #include "Writer.hpp"
+#include "Encoder.hpp"
+#include "Ladder.hpp"
+#include "Segmenter.hpp"
+#include "HttpServer.hpp"
+#include "Restreamer.hpp"
+#include "MotionDetector.hpp"
+#include "HealthMonitor.hpp"
+#include "Fanout.hpp"
 
 namespace avio {
 
@@ -54,6 +64,10 @@ public:
     std::function<void(float progress, const std::string& uri)> progressCallback = nullptr;
     std::function<void(const Frame&, const std::string& uri)> renderCallback = nullptr;
     std::function<void(const Frame&, const std::string& uri)> pyAudioCallback = nullptr;
+    std::function<void(const AudioLevel& level, const std::string& uri)> audioLevelCallback = nullptr;
+    std::function<void(const Activity& activity, const std::string& uri)> activityCallback = nullptr;
+    std::function<void(const Motion& motion, const std::string& uri)> motionCallback = nullptr;
+    std::function<void(const HealthEvent& event, const std::string& uri)> healthCallback = nullptr;
     std::function<void(const std::string& uri)> mediaPlayingStarted = nullptr;
     std::function<void(const std::string& uri)> mediaPlayingStopped = nullptr;
     std::function<void(const std::string& uri)> packetDrop = nullptr;
@@ -64,9 +78,61 @@ public:
     int buffer_size_in_seconds = 1;
     float file_start_from_seek = -1.0;
     int audio_driver_index = 0;
+    bool mix_audio = false;
+    bool headless_audio = false;        // audio is analyzed but not played, no device is opened
+    int audio_level_window_ms = 100;
+    float silence_threshold_db = -50.0f;
+    int silence_min_ms = 2000;
+    bool audio_loudness = false;
     bool disable_video = false;
     bool disable_audio = false;
     bool hidden = false;
+    bool async_io = false;
+    bool fragmented = false;
+    int segment_duration_in_seconds = 0;
+    std::string catalog_path;
+    int timeshift_seconds = 0;
+    int timeshift_ram_seconds = 30;
+    std::string timeshift_dir;
+    std::string str_sync_master = "auto";
+    int late_frame_threshold_ms = 100;
+    bool drop_late_live = false;
+    int latency_target_ms = 0;
+    bool transcode = false;             // recordings are encoded from the filtered frames instead of copied
+    std::string video_encoder_name = "libx264";
+    std::string audio_encoder_name = "aac";
+    std::string encoder_preset = "veryfast";
+    int encoder_crf = 28;
+    int64_t video_bit_rate = 0;         // zero encodes video at constant quality
+    int64_t audio_bit_rate = 64000;
+    int encoder_threads = 0;
+    bool hls = false;                   // live playlist of the stream for browsers
+    std::string hls_directory;          // empty keeps the playlist in memory
+    bool hls_low_latency = false;
+    int hls_segment_seconds = 2;
+    float hls_part_seconds = 0.5f;
+    int hls_list_size = 6;
+    int hls_http_port = 0;              // serves the playlist for testing when set
+    int restream_port = 0;              // serves the stream to other readers as mpeg-ts over tcp when set
+    std::string restream_address = "127.0.0.1";
+    int restream_queue_size = 256;
+    bool activity_detection = false;    // judges activity from the video packets, works without decoding
+    float activity_threshold = 0.5f;
+    int activity_hold_ms = 5000;
+    bool activity_motion_vectors = false;
+    bool activity_record = false;       // recording follows the activity
+    std::string activity_filename;      // base name of the activity recordings, the start time is appended
+    bool motion_detection = false;      // pixel motion on a downscaled copy of the decoded luma
+    int motion_interval_ms = 200;
+    int motion_width = 160;
+    int motion_threshold = 20;
+    float motion_cell_threshold = 0.05f;
+    bool health_monitoring = false;     // black, frozen and scene change checks on the decoded luma
+    int health_interval_ms = 500;
+    int black_min_ms = 2000;
+    int freeze_min_ms = 5000;
+    float freeze_threshold = 0.5f;
+    float scene_threshold = 0.35f;
     float volume = 1.0;
     bool mute = false;
     AVRational onvif_frame_rate;
@@ -78,7 +144,38 @@ public:
     Filter* audio_filter   = nullptr;
     Display* display       = nullptr;
     Audio* audio           = nullptr;
+    AudioAnalyzer* analyzer = nullptr;
     Writer* writer         = nullptr;
+    Fanout* fanout         = nullptr;
+    Catalog* catalog       = nullptr;
+    Timeshift* timeshift   = nullptr;
+    Encoder* video_encoder = nullptr;
+    Encoder* audio_encoder = nullptr;
+    ActivityDetector* activity = nullptr;
+    MotionDetector* motion = nullptr;
+    HealthMonitor* health = nullptr;
+    bool activity_recording = false;
+
+    // additional recording outputs by name, with their pre-record buffer size in seconds
+    std::map<std::string, int> outputs;
+
+    // recordings of the live stream at other sizes, encoded from the one decode
+    std::vector<Rendition> renditions;
+    Ladder* ladder = nullptr;
+    Segmenter* segmenter = nullptr;
+    HttpServer* http_server = nullptr;
+    Restreamer* restreamer = nullptr;
+
+    // optional high resolution companion of uri, decoded only while it is on screen
+    std::string main_uri;
+    std::atomic<bool> main_stream { false };
+    bool main_requested = false;
+    std::atomic<bool> main_running { false };
+    Reader* main_reader    = nullptr;
+    Decoder* main_decoder  = nullptr;
+    Filter* main_filter    = nullptr;
+    std::thread* main_thread = nullptr;
+    std::mutex main_mutex;
 
     Player(const std::string& uri) : uri(uri) { av_log_set_level(log_level); }
     ~Player() { }
@@ -117,18 +214,30 @@ public:
         std::thread* audio_filter_thread  = nullptr;
         std::thread* display_thread       = nullptr;
         std::thread* writer_thread        = nullptr;
+        std::thread* timeshift_thread     = nullptr;
+        std::thread* analyzer_thread      = nullptr;
+        std::thread* video_encoder_thread = nullptr;
+        std::thread* audio_encoder_thread = nullptr;
 
-        Queue<Packet> video_pkts(128);
-        Queue<Packet> audio_pkts(128);
+        // a live stream with a latency target keeps only a few packets in flight
+        bool low_latency = live_stream && latency_target_ms > 0;
+        int pkt_queue_size = low_latency ? 16 : 128;
+
+        Queue<Packet> video_pkts(pkt_queue_size);
+        Queue<Packet> audio_pkts(pkt_queue_size);
         Queue<Frame>  decoded_video_frames(1);
         Queue<Frame>  decoded_audio_frames(1);
         Queue<Frame>  filtered_video_frames(1);
         Queue<Frame>  filtered_audio_frames(1);
         Queue<Packet> writer_pkts(128);
+        Queue<Frame>  video_writer_frames(8);
+        Queue<Frame>  audio_writer_frames(32);
+        Queue<Frame>  ladder_frames(8);
 
         try {
-            reader = new Reader(uri);
+            reader = new Reader(uri, low_latency);
             reader->clear_callback = clear_callback;
+            if (low_latency) reader->latency_target = latency_target_ms;
             reader->player = this;
             reader->live_stream = live_stream;
             reader->packetDrop = packetDrop;
@@ -137,20 +246,112 @@ public:
             reader->disable_audio = disable_audio;
             reader->disable_video = disable_video;
 
+            if (activity_detection && reader->has_video() && !disable_video)
+                create_activity_detector();
+
             if (!disable_video && !hidden)
                 reader->video_pkts = &video_pkts;
             if (!disable_audio && !hidden)
                 reader->audio_pkts = &audio_pkts;
 
+            // the setting is left as it is for the next play, only this one may fall back to copying
+            bool encode_recording = transcode;
+            bool encode_renditions = live_stream && renditions.size() && reader->has_video() && !disable_video;
+            if (live_stream && (encode_recording || encode_renditions) && (hidden || timeshift_seconds > 0)) {
+                // the encoders need the decoded live frames, which are not there in either case
+                std::cout << uri << " transcoding is not available " << (hidden ? "when hidden" : "with timeshift")
+                          << ", the recording is copied" << std::endl;
+                encode_recording = false;
+                encode_renditions = false;
+            }
+
             if (live_stream) {
                 writer = new Writer(reader);
                 writer->disable_audio = disable_audio;
                 writer->disable_video = disable_video;
-                writer->input = &writer_pkts;
+                writer->async_io = async_io;
+                writer->fragmented = fragmented;
+                writer->segment_duration_in_seconds = segment_duration_in_seconds;
+                if (!catalog_path.empty() && segment_duration_in_seconds > 0) {
+                    std::cout << uri << " segmented recordings are not cataloged" << std::endl;
+                }
+                else if (!catalog_path.empty()) {
+                    catalog = new Catalog(catalog_path);
+                    writer->catalog = catalog;
+                }
+                if (encode_recording)
+                    create_encoders(&video_writer_frames, &audio_writer_frames, &writer_pkts);
+                if (encode_renditions) {
+                    ladder = new Ladder(reader, renditions, &ladder_frames, video_encoder_name, encoder_preset, encoder_crf, encoder_threads);
+                    if (video_encoder) ladder->forward = &video_writer_frames;
+                    if (!encode_recording) ladder->forward_pkts = &writer_pkts;
+                }
+                fanout = new Fanout(reader, writer);
+                for (const auto& output : outputs)
+                    fanout->add(output.first, output.second);
+                if (hls) {
+                    segmenter = new Segmenter(reader, hls_directory);
+                    segmenter->low_latency = hls_low_latency;
+                    if (hls_low_latency && hls_directory.empty()) {
+                        // the store only holds finished files, segments announced early would not be found
+                        std::cout << uri << " low latency hls needs a directory, the playlist is regular hls" << std::endl;
+                        segmenter->low_latency = false;
+                    }
+                    segmenter->segment_seconds = hls_segment_seconds;
+                    segmenter->part_seconds = hls_part_seconds;
+                    segmenter->list_size = hls_list_size;
+                    segmenter->disable_audio = disable_audio;
+                    segmenter->video_encoder = video_encoder;
+                    segmenter->audio_encoder = audio_encoder;
+                    fanout->segmenter = segmenter;
+                    if (hls_http_port > 0) {
+                        http_server = new HttpServer(segmenter, hls_http_port);
+                        try {
+                            http_server->start();
+                            std::cout << uri << " playlist at " << http_server->url() << std::endl;
+                        }
+                        catch (const std::exception& e) {
+                            // the playlist is still made, it just isn't served
+                            std::cout << uri << " " << e.what() << std::endl;
+                            delete http_server;
+                            http_server = nullptr;
+                        }
+                    }
+                }
+                if (restream_port > 0) {
+                    restreamer = new Restreamer(reader, restream_port);
+                    restreamer->address = restream_address;
+                    restreamer->max_queue = std::max(2, restream_queue_size);
+                    restreamer->disable_audio = disable_audio;
+                    restreamer->video_encoder = video_encoder;
+                    restreamer->audio_encoder = audio_encoder;
+                    try {
+                        restreamer->start();
+                        fanout->restreamer = restreamer;
+                        std::cout << uri << " restreaming at " << restreamer->url() << std::endl;
+                    }
+                    catch (const std::exception& e) {
+                        std::cout << uri << " " << e.what() << std::endl;
+                        delete restreamer;
+                        restreamer = nullptr;
+                    }
+                }
                 if (hidden) {
-                    reader->writer_pkts = &writer_pkts;
+                    // record only, nothing is decoded and the writers run on the reader thread
+                    reader->pkt_handle = [&](Packet&& pkt) { fanout->write(std::move(pkt)); };
+                }
+                else {
+                    fanout->input = &writer_pkts;
                 }
             }
+
+            if (live_stream && !hidden && timeshift_seconds > 0) {
+                int key_stream = (reader->has_video() && !disable_video) ? reader->video_stream_index : reader->audio_stream_index;
+                timeshift = new Timeshift(key_stream, timeshift_seconds, timeshift_ram_seconds, timeshift_dir);
+                // the recorder is fed straight from the buffer rather than after decoding
+                if (writer) timeshift->writer_pkts = &writer_pkts;
+                reader->timeshift = timeshift;
+            }
             
             if (file_start_from_seek > 0.0)
                 seek(file_start_from_seek);
@@ -162,26 +363,64 @@ public:
                     if (type != AV_HWDEVICE_TYPE_NONE)
                         std::cout << "using hw decoder " << str_hw_device_type << std::endl;
                 }
-                video_decoder = new Decoder(reader, AVMEDIA_TYPE_VIDEO, &video_pkts, &decoded_video_frames, type);
-                if (live_stream)
-                    video_decoder->writer_pkts = &writer_pkts;
+                video_decoder = new Decoder(reader, AVMEDIA_TYPE_VIDEO, &video_pkts, &decoded_video_frames, type, low_latency);
+                if (live_stream && !timeshift && !encode_recording) {
+                    // the low latency catch up skips packets before the decoder, the recorder has to see them first
+                    if (reader->latency_target > 0)
+                        reader->writer_video_pkts = &writer_pkts;
+                    else
+                        video_decoder->writer_pkts = &writer_pkts;
+                }
                 video_filter = new Filter(video_decoder, str_video_filter, &decoded_video_frames, &filtered_video_frames);
+                if (ladder)
+                    video_filter->writer_frames = &ladder_frames;
+                else if (video_encoder)
+                    video_filter->writer_frames = &video_writer_frames;
+                create_frame_analysis();
+            }
+            else if ((motion_detection || health_monitoring) && reader->has_video() && !disable_video) {
+                std::cout << uri << " frame analysis needs the video decoded, it is not available when hidden" << std::endl;
             }
 
             if (reader->has_audio() && !disable_audio && !hidden) {
                 try {
-                    audio = new Audio(reader, &filtered_audio_frames, audio_driver_index);
-                    audio->volume = volume;
-                    audio->mute = mute;
-                    audio->pyAudioCallback = pyAudioCallback;
-                    if (!reader->has_video())
-                        audio->progressCallback = progressCallback;
+                    if (audioLevelCallback || headless_audio) {
+                        analyzer = new AudioAnalyzer(reader);
+                        analyzer->window_ms = audio_level_window_ms;
+                        analyzer->silence_threshold = silence_threshold_db;
+                        analyzer->silence_min_ms = silence_min_ms;
+                        analyzer->loudness = audio_loudness;
+                        analyzer->audioLevelCallback = audioLevelCallback;
+                    }
+                    if (!headless_audio) {
+                        audio = new Audio(reader, &filtered_audio_frames, audio_driver_index, mix_audio);
+                        audio->volume = volume;
+                        audio->mute = mute;
+                        audio->analyzer = analyzer;
+                        audio->pyAudioCallback = pyAudioCallback;
+                        if (!reader->has_video())
+                            audio->progressCallback = progressCallback;
+                    }
                     audio_decoder = new Decoder(reader, AVMEDIA_TYPE_AUDIO, &audio_pkts, &decoded_audio_frames);
-                    if (live_stream)
-                        audio_decoder->writer_pkts = &writer_pkts;
+                    Queue<Packet>* audio_writer_pkts = nullptr;
+                    if (ladder)
+                        audio_writer_pkts = &ladder->audio_pkts;
+                    else if (live_stream && !timeshift && !encode_recording)
+                        audio_writer_pkts = &writer_pkts;
+                    if (reader->latency_target > 0)
+                        reader->writer_audio_pkts = audio_writer_pkts;
+                    else
+                        audio_decoder->writer_pkts = audio_writer_pkts;
                     audio_filter = new Filter(audio_decoder, str_audio_filter, &decoded_audio_frames, &filtered_audio_frames);
+                    if (audio_encoder)
+                        audio_filter->writer_frames = &audio_writer_frames;
                     audio_decoder_thread = new std::thread([&] { while (audio_decoder->decode()) {} });
                     audio_filter_thread = new std::thread([&] { while (audio_filter->filter()) {} });
+                    if (headless_audio) {
+                        // the analyzer is the only consumer of the audio, it runs as fast as frames arrive
+                        analyzer->frames = &filtered_audio_frames;
+                        analyzer_thread = new std::thread([&] { while (analyzer->run()) {} });
+                    }
                 }
                 catch (const std::exception& e) {
                     if (infoCallback) 
@@ -191,18 +430,55 @@ public:
                     disable_audio = true;
                     reader->disable_audio = true;
                     reader->audio_pkts = nullptr;
+                    reader->writer_audio_pkts = nullptr;
+                }
+            }
+
+            if (audio_encoder && !audio_filter) {
+                // nothing will reach the audio encoder, the recording goes without sound
+                writer->disable_audio = true;
+                delete audio_encoder;
+                audio_encoder = nullptr;
+                writer->audio_encoder = nullptr;
+                for (const auto& output : fanout->outputs) {
+                    output.second->disable_audio = true;
+                    output.second->audio_encoder = nullptr;
+                }
+                if (segmenter) {
+                    segmenter->disable_audio = true;
+                    segmenter->audio_encoder = nullptr;
+                }
+                if (restreamer) {
+                    restreamer->disable_audio = true;
+                    restreamer->audio_encoder = nullptr;
                 }
             }
+            if (ladder)
+                ladder->start(audio_filter != nullptr);
+            if (video_encoder)
+                video_encoder_thread = new std::thread([&] { while (video_encoder->encode()) {} });
+            if (audio_encoder)
+                audio_encoder_thread = new std::thread([&] { while (audio_encoder->encode()) {} });
+
+            // live video is shown as it arrives unless asked to drop, the latency is managed upstream
+            reader->clock.master = SyncClock::master_from_string(str_sync_master, audio != nullptr);
+            reader->clock.late_threshold = (live_stream && !drop_late_live) ? 0 : late_frame_threshold_ms;
+            reader->drop_late_live = live_stream && drop_late_live;
 
-            reader_thread = new std::thread([&] { while (reader->read()) {} });
+            if (!hidden)
+                reader_thread = new std::thread([&] { while (reader->read()) {} });
 
             if (video_decoder) {
                 video_decoder_thread = new std::thread([&] { while (video_decoder->decode()) {} });
                 video_filter_thread = new std::thread([&] { while (video_filter->filter()) {} });
             }
 
-            if (writer) {
-                writer_thread = new std::thread([&] { while (writer->write()) {} });
+            if (writer && !hidden) {
+                writer_thread = new std::thread([&] { while (fanout->write()) {} });
+            }
+
+            if (timeshift) {
+                timeshift_thread = new std::thread([&] { while (feed_timeshift(&video_pkts, &audio_pkts)) {} });
             }
 
             if (mediaPlayingStarted) {
@@ -219,6 +495,10 @@ public:
                     while (display->render()) {}
             }
 
+            if (hidden) {
+                while (reader->read()) {}
+            }
+
         }
         catch (const std::exception& e) {
             if (errorCallback) {
@@ -232,12 +512,18 @@ public:
         }
 
         if (display_thread)       display_thread->join();
+        stop_main_stream();
         if (audio_filter_thread)  audio_filter_thread->join();
         if (audio_decoder_thread) audio_decoder_thread->join();
         if (video_filter_thread)  video_filter_thread->join();
         if (video_decoder_thread) video_decoder_thread->join();
+        if (ladder)               ladder->join();
         if (reader_thread)        reader_thread->join();
         if (writer_thread)        writer_thread->join();
+        if (timeshift_thread)     timeshift_thread->join();
+        if (analyzer_thread)      analyzer_thread->join();
+        if (video_encoder_thread) video_encoder_thread->join();
+        if (audio_encoder_thread) audio_encoder_thread->join();
 
         if (display_thread)       { delete display_thread;       display_thread       = nullptr; }
         if (audio_filter_thread)  { delete audio_filter_thread;  audio_filter_thread  = nullptr; }
@@ -246,9 +532,26 @@ public:
         if (video_decoder_thread) { delete video_decoder_thread; video_filter_thread  = nullptr; }
         if (writer_thread)        { delete writer_thread;        writer_thread        = nullptr; }
         if (reader_thread)        { delete reader_thread;        reader_thread        = nullptr; }
+        if (timeshift_thread)     { delete timeshift_thread;     timeshift_thread     = nullptr; }
+        if (analyzer_thread)      { delete analyzer_thread;      analyzer_thread      = nullptr; }
+        if (video_encoder_thread) { delete video_encoder_thread; video_encoder_thread = nullptr; }
+        if (audio_encoder_thread) { delete audio_encoder_thread; audio_encoder_thread = nullptr; }
 
         if (display)              { delete display;              display              = nullptr; }
+        if (fanout)               { delete fanout;               fanout               = nullptr; }
+        if (http_server)          { delete http_server;          http_server          = nullptr; }
+        if (segmenter)            { delete segmenter;            segmenter            = nullptr; }
+        if (restreamer)           { delete restreamer;           restreamer           = nullptr; }
         if (writer)               { delete writer;               writer               = nullptr; }
+        if (catalog)              { delete catalog;              catalog              = nullptr; }
+        if (ladder)               { delete ladder;               ladder               = nullptr; }
+        if (video_encoder)        { delete video_encoder;        video_encoder        = nullptr; }
+        if (audio_encoder)        { delete audio_encoder;        audio_encoder        = nullptr; }
+        if (timeshift) {
+            if (reader) reader->timeshift = nullptr;
+            delete timeshift;
+            timeshift = nullptr;
+        }
         if (video_filter)         { delete video_filter;         video_filter         = nullptr; }
         if (video_decoder)        { delete video_decoder;        video_decoder        = nullptr; }
         if (audio_filter)         { delete audio_filter;         audio_filter         = nullptr; }
@@ -266,7 +569,12 @@ public:
             delete audio;
             audio = nullptr;
         }
+        if (analyzer)             { delete analyzer;             analyzer             = nullptr; }
         if (reader)               { delete reader;               reader               = nullptr; }
+        if (activity)             { delete activity;             activity             = nullptr; }
+        if (motion)               { delete motion;               motion               = nullptr; }
+        if (health)               { delete health;               health               = nullptr; }
+        activity_recording = false;
 
         if (mediaPlayingStopped) {
             std::thread thread([&]() { 
@@ -276,6 +584,70 @@ public:
         }
     }
 
+    void create_encoders(Queue<Frame>* video_frames, Queue<Frame>* audio_frames, Queue<Packet>* pkts) {
+        if (reader->has_video() && !disable_video) {
+            video_encoder = new Encoder(reader, AVMEDIA_TYPE_VIDEO, video_frames, pkts, video_encoder_name);
+            video_encoder->preset = encoder_preset;
+            video_encoder->crf = encoder_crf;
+            video_encoder->bit_rate = video_bit_rate;
+            video_encoder->threads = encoder_threads;
+            writer->video_encoder = video_encoder;
+        }
+        if (reader->has_audio() && !disable_audio) {
+            audio_encoder = new Encoder(reader, AVMEDIA_TYPE_AUDIO, audio_frames, pkts, audio_encoder_name);
+            audio_encoder->bit_rate = audio_bit_rate;
+            writer->audio_encoder = audio_encoder;
+        }
+    }
+
+    // plays the timeshift buffer into the decoders, pacing comes from the display and audio downstream
+    int feed_timeshift(Queue<Packet>* video_pkts, Queue<Packet>* audio_pkts) {
+        Packet pkt;
+        uint64_t generation = 0;
+        int ret = timeshift->next(pkt, generation);
+        if (ret == 0)
+            return 0;
+        if (ret < 0) {
+            // playback has caught up with the stream
+            reader->timeshift_to(INT64_MAX);
+            return 1;
+        }
+        if (reader->terminated || !timeshift->is_current(generation))
+            return 1;
+        if (pkt.stream_index() == reader->video_stream_index && reader->video_pkts)
+            video_pkts->push(std::move(pkt));
+        else if (pkt.stream_index() == reader->audio_stream_index && reader->audio_pkts)
+            audio_pkts->push(std::move(pkt));
+        return 1;
+    }
+
+    // stream time in milliseconds of what is being presented
+    int64_t position() const {
+        if (display && display->last_time >= 0)
+            return display->last_time;
+        if (reader && reader->clock.audio.valid())
+            return reader->clock.audio.last();
+        return timeshift ? timeshift->live_edge() : -1;
+    }
+
+    void rewind(float seconds) {
+        if (!reader || !reader->timeshift) return;
+        reader->timeshift_to(position() - (int64_t)(seconds * 1000));
+    }
+
+    void goLive() {
+        if (reader) reader->timeshift_to(INT64_MAX);
+    }
+
+    int64_t timeshiftDelay() const {
+        return (reader && reader->timeshift) ? reader->timeshift->delay() : 0;
+    }
+
+    float timeshiftAvailable() const {
+        if (!reader || !reader->timeshift) return 0;
+        return (reader->timeshift->live_edge() - reader->timeshift->earliest()) / 1000.0f;
+    }
+
     void start() {
         std::thread thread([&]() { play(); });
         thread.detach();
@@ -288,9 +660,141 @@ public:
         thread.detach();
     }
 
+    void setMainStream(bool arg) {
+        std::lock_guard<std::mutex> lock(main_mutex);
+        if (arg) {
+            if (main_uri.empty() || !reader || reader->closed || !video_filter)
+                return;
+            if (main_thread) {
+                if (main_running)
+                    return;
+                main_thread->join();
+                delete main_thread;
+                main_thread = nullptr;
+            }
+            main_requested = true;
+            main_running = true;
+            main_thread = new std::thread([&] { run_main_stream(); });
+        }
+        else {
+            // the sub stream never stopped decoding, so it can take over the display immediately
+            main_requested = false;
+            main_stream = false;
+            if (video_filter) video_filter->suspended = false;
+            if (main_filter)  main_filter->suspended = true;
+            if (main_reader)  main_reader->terminate();
+        }
+    }
+
+    void run_main_stream() {
+        Queue<Packet> main_pkts(128);
+        Queue<Frame>  main_frames(1);
+        Reader* r  = nullptr;
+        Decoder* d = nullptr;
+        Filter* f  = nullptr;
+        std::thread* decoder_thread = nullptr;
+        std::thread* filter_thread  = nullptr;
+
+        try {
+            r = new Reader(main_uri);
+            r->live_stream = true;
+            r->disable_audio = true;
+            r->infoCallback = infoCallback;
+            r->video_pkts = &main_pkts;
+            r->wait_for_key_frame = true;
+            if (!r->has_video())
+                throw std::runtime_error("main stream has no video");
+
+            AVHWDeviceType type = AV_HWDEVICE_TYPE_NONE;
+            if (!str_hw_device_type.empty())
+                type = av_hwdevice_find_type_by_name(str_hw_device_type.c_str());
+            d = new Decoder(r, AVMEDIA_TYPE_VIDEO, &main_pkts, &main_frames, type);
+
+            // the main stream filter feeds the same display queue as the sub stream, the sub stream
+            // is suspended once the first main stream frame is ready so the switch has no gap
+            f = new Filter(d, str_video_filter, &main_frames, video_filter->output);
+            f->secondary = true;
+            f->first_frame_callback = [&]() {
+                std::lock_guard<std::mutex> lock(main_mutex);
+                if (main_requested) {
+                    if (video_filter) video_filter->suspended = true;
+                    main_stream = true;
+                }
+            };
+
+            {
+                std::lock_guard<std::mutex> lock(main_mutex);
+                main_reader = r;
+                main_decoder = d;
+                main_filter = f;
+                if (!main_requested) {
+                    f->suspended = true;
+                    r->terminate();
+                }
+            }
+
+            decoder_thread = new std::thread([&] { while (d->decode()) {} });
+            filter_thread = new std::thread([&] { while (f->filter()) {} });
+            while (r->read()) {}
+        }
+        catch (const std::exception& e) {
+            std::stringstream str;
+            str << "main stream error: " << e.what();
+            if (infoCallback)
+                infoCallback(str.str(), uri);
+            else
+                std::cout << uri << " " << str.str() << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(main_mutex);
+            if (f) f->suspended = true;
+            if (video_filter) video_filter->suspended = false;
+            main_stream = false;
+        }
+
+        if (filter_thread)  { filter_thread->join();  delete filter_thread; }
+        if (decoder_thread) { decoder_thread->join(); delete decoder_thread; }
+
+        {
+            std::lock_guard<std::mutex> lock(main_mutex);
+            main_reader = nullptr;
+            main_decoder = nullptr;
+            main_filter = nullptr;
+        }
+
+        if (f) delete f;
+        if (d) delete d;
+        if (r) delete r;
+        main_running = false;
+    }
+
+    void stop_main_stream() {
+        if (!main_thread)
+            return;
+        setMainStream(false);
+        // The display has closed, main stream frames may be waiting on its queue. It holds one frame, so it is
+        // cleared until the main thread has wound down rather than once, the filter could refill it in between.
+        while (main_running) {
+            if (video_filter) video_filter->output->clear();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        main_thread->join();
+        delete main_thread;
+        main_thread = nullptr;
+    }
+
     void seek(float pct) {
         if (!reader) return;
         if (reader->closed) return;
+        if (reader->live_stream) {
+            // on a live stream the position is taken across the span of the timeshift buffer
+            if (reader->timeshift) {
+                int64_t earliest = reader->timeshift->earliest();
+                reader->timeshift_to(earliest + (int64_t)(pct * (reader->timeshift->live_edge() - earliest)));
+            }
+            return;
+        }
         AVRational time_base = reader->video_time_base();
         if (!reader->has_video())
             time_base = reader->audio_time_base();
@@ -309,8 +813,14 @@ public:
     int         width()            const { return reader ? reader->width() : -1; }
     int         height()           const { return reader ? reader->height() : -1; }
     bool        isPaused()         const { return reader ? reader->paused : false; }
+    bool        isTimeshifting()   const { return reader ? reader->is_timeshifting() : false; }
     bool        isRecording()      const { return reader ? reader->recording : false; }
     bool        isMuted()          const { return audio ? audio->mute : false; }
+    float       getAudioLevel()    const { return audio ? audio->peak.load() : 0.0f; }
+    int64_t     droppedFrames()    const { return reader ? reader->clock.dropped.load() : 0; }
+    int64_t     getLatency()       const { return reader ? reader->latency.estimate() : -1; }
+    int64_t     latencyCatchUps()  const { return reader ? reader->catch_ups : 0; }
+    bool        isMainStream()     const { return main_stream; }
     bool        hasVideo()         const { return reader ? reader->has_video() : false; }
     bool        hasAudio()         const { return reader ? reader->has_audio() : false; }
     int64_t     duration()         const { return reader ? reader->duration() : 0; }
@@ -318,6 +828,10 @@ public:
     std::string getAudioCodec()    const { return reader ? reader->str_audio_codec() : "unknown"; }
 
 
+    std::map<std::string, int64_t> getIOStats() const {
+        return writer ? writer->io_stats.to_map() : std::map<std::string, int64_t>();
+    }
+
     std::string getStreamInfo() const {
         return reader ? reader->get_stream_info() : "no stream info available";
     }
@@ -369,7 +883,11 @@ public:
     }
 
     void togglePaused() { 
-        if (reader) reader->paused = !reader->paused; 
+        if (!reader) return;
+        // a live stream with a timeshift buffer holds its place while paused and resumes from there
+        if (reader->live_stream && reader->timeshift && !reader->paused && !reader->is_timeshifting())
+            reader->timeshift_to(position());
+        reader->paused = !reader->paused; 
     }
 
     void setVolume(int arg) {
@@ -394,23 +912,157 @@ public:
         if (reader) reader->recording = !reader->recording;
     }
 
-    void startFileBreak(const std::string& filename) {
-        if (writer) writer->filename = filename;
-        std::thread thread([&]() { file_break(); });
-        thread.detach();
+    void create_activity_detector() {
+        activity = new ActivityDetector(uri, reader->fmt_ctx->streams[reader->video_stream_index]);
+        activity->threshold = activity_threshold;
+        activity->hold_ms = activity_hold_ms;
+        activity->activityCallback = activityCallback;
+        // motion vectors come from the decoder, there is none when hidden
+        activity->motion_vectors = activity_motion_vectors && !hidden;
+        if (activity->motion_vectors && !str_hw_device_type.empty())
+            std::cout << uri << " hardware decoders do not export motion vectors, activity is judged from the bit rate" << std::endl;
+        if (activity_record) {
+            activity->trigger = [this](bool active) {
+                // the reader thread calls this, the writer picks the change up with the next packet
+                if (!writer || !reader) return;
+                if (active && !reader->recording) {
+                    writer->filename = activity_file_name();
+                    activity_recording = true;
+                    reader->recording = true;
+                }
+                else if (!active && activity_recording) {
+                    // a recording started by hand is left alone
+                    reader->recording = false;
+                    activity_recording = false;
+                }
+            };
+        }
+        reader->activity = activity;
     }
 
-    void file_break() {
-        if (reader && writer) {
-            if (reader->recording) {
-                reader->recording = false;
-                while (writer->fmt_ctx) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                    if (!writer)
-                        return;
-                }
-                if (reader) reader->recording = true;
-            }
+    std::string activity_file_name() const {
+        char stamp[32];
+        time_t now = time(nullptr);
+        strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", localtime(&now));
+        std::string base = activity_filename.empty() ? "activity" : activity_filename;
+        return base + "_" + stamp;
+    }
+
+    // the latest reading, the score is zero when detection is off
+    Activity getActivity() {
+        return activity ? activity->current() : Activity();
+    }
+
+    void create_frame_analysis() {
+        if (motion_detection) {
+            motion = new MotionDetector(uri);
+            motion->interval_ms = motion_interval_ms;
+            motion->sampler.max_width = std::max(16, motion_width);
+            motion->threshold = motion_threshold;
+            motion->cell_threshold = motion_cell_threshold;
+            motion->motionCallback = motionCallback;
+        }
+        if (health_monitoring) {
+            health = new HealthMonitor(uri);
+            health->interval_ms = health_interval_ms;
+            health->black_min_ms = black_min_ms;
+            health->freeze_min_ms = freeze_min_ms;
+            health->freeze_threshold = freeze_threshold;
+            health->scene_threshold = scene_threshold;
+            health->healthCallback = healthCallback;
+        }
+        if (motion || health) {
+            video_decoder->frame_handle = [this](const AVFrame* frame) {
+                int64_t time = reader->real_time(reader->video_stream_index, frame->pts);
+                if (motion) motion->frame(frame, time);
+                if (health) health->frame(frame, time);
+            };
+        }
+    }
+
+    // the latest sample, empty when detection is off
+    Motion getMotion() {
+        return motion ? motion->current() : Motion();
+    }
+
+    Health getHealth() {
+        return health ? health->current() : Health();
+    }
+
+    void addOutput(const std::string& name, int buffer_size_in_seconds) {
+        outputs[name] = buffer_size_in_seconds;
+        if (fanout) fanout->add(name, buffer_size_in_seconds);
+    }
+
+    void removeOutput(const std::string& name) {
+        outputs.erase(name);
+        if (fanout) fanout->remove(name);
+    }
+
+    bool startOutput(const std::string& name, const std::string& filename) {
+        return fanout ? fanout->start(name, filename) : false;
+    }
+
+    void stopOutput(const std::string& name) {
+        if (fanout) fanout->stop(name);
+    }
+
+    bool isOutputRecording(const std::string& name) {
+        return fanout ? fanout->is_recording(name) : false;
+    }
+
+    // the address of the live playlist when it is served, empty otherwise
+    std::string getHlsUrl() const {
+        return http_server ? http_server->url() : "";
+    }
+
+    std::string getRestreamUrl() const {
+        return restreamer ? restreamer->url() : "";
+    }
+
+    int restreamClients() {
+        return restreamer ? (int)restreamer->client_count() : 0;
+    }
+
+    int64_t restreamDrops() const {
+        return restreamer ? (int64_t)restreamer->drops : 0;
+    }
+
+    // renditions are set up before play, each has its own recording switch like the outputs
+    void addRendition(const std::string& name, int width, int height, int64_t bit_rate) {
+        Rendition rendition;
+        rendition.name = name;
+        rendition.width = width;
+        rendition.height = height;
+        rendition.bit_rate = bit_rate;
+        renditions.push_back(rendition);
+    }
+
+    bool startRendition(const std::string& name, const std::string& filename) {
+        LadderStep* step = ladder ? ladder->find(name) : nullptr;
+        if (!step) return false;
+        step->writer->filename = filename;
+        step->writer->recording = true;
+        return true;
+    }
+
+    void stopRendition(const std::string& name) {
+        LadderStep* step = ladder ? ladder->find(name) : nullptr;
+        if (step) step->writer->recording = false;
+    }
+
+    bool isRenditionRecording(const std::string& name) {
+        LadderStep* step = ladder ? ladder->find(name) : nullptr;
+        return step ? step->writer->recording : false;
+    }
+
+    void startFileBreak(const std::string& filename) {
+        // the writer opens the next file in the background and switches to it at a key frame, no packets are lost
+        if (writer) {
+            if (reader && reader->recording)
+                writer->rollover(filename);
+            else
+                writer->filename = filename;
         }
     }
 
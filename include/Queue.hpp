@@ -110,41 +110,6 @@ public:
             cv_full.notify_all();
         }
     }
-
-    size_t find_pts(int64_t pts) {
-        std::lock_guard<std::mutex> lock(mutex);
-        if constexpr(std::is_same_v<T, Packet>) {
-            for (int i = 0; i < queue.size(); i++) {
-                if (queue[i].pts() >= pts)
-                    return i;
-            }
-        }
-        return SIZE_MAX;
-    }
-
-    size_t find_last_key_frame(size_t starting_index) {
-        std::lock_guard<std::mutex> lock(mutex);
-        if constexpr(std::is_same_v<T, Packet>) {
-            for (int i = starting_index; i >= 0; i--) {
-                if (i < queue.size()) {
-                    if (queue[i].is_key_frame())
-                        return i;
-                }
-            }
-        }
-        return SIZE_MAX; 
-    }
-
-    size_t find_first_key_frame(size_t starting_index) {
-        std::lock_guard<std::mutex> lock(mutex);
-        if constexpr(std::is_same_v<T, Packet>) {
-            for (int i = starting_index; i < queue.size(); i++) {
-                if (queue[i].is_key_frame())
-                    return i;
-            }
-        }
-        return SIZE_MAX;
-    }
 };
 
 }
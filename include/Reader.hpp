@@ -22,6 +22,7 @@
 
 #include <iostream>
 #include <functional>
+#include <atomic>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -31,6 +32,9 @@ extern "C" {
 #include "Queue.hpp"
 #include "Filter.hpp"
 #include "Exception.hpp"
+#include "Timeshift.hpp"
+#include "Clock.hpp"
+#include "ActivityDetector.hpp"
 
 struct CallbackParams {
     time_t timeout_start = time(nullptr);
@@ -55,14 +59,12 @@ public:
     std::string uri;
     Queue<Packet>* video_pkts = nullptr;
     Queue<Packet>* audio_pkts = nullptr;
-    Queue<Packet>* writer_pkts = nullptr;
     int video_stream_index = -1;
     int audio_stream_index = -1;
     AVFormatContext* fmt_ctx = nullptr;
     AVPacket* pkt = nullptr;
     //time_t timeout_start = time(nullptr);
-    int64_t last_audio_rts = INT64_MAX;
-    int64_t last_video_rts = INT64_MAX;
+    SyncClock clock;
     int64_t last_audio_pts = AV_NOPTS_VALUE;
     int64_t last_video_pts = AV_NOPTS_VALUE;
     bool terminated = false;
@@ -75,17 +77,38 @@ public:
     bool paused = false;
     bool disable_video = false;
     bool disable_audio = false;
+    std::atomic<bool> wait_for_key_frame { false };
+    int64_t latency_target = 0;         // milliseconds, live video is skipped ahead to a key frame beyond this
+    LatencyMeter latency;
+    int64_t catch_ups = 0;
     CallbackParams callback_params;
 
     std::function<void(const std::string& uri)> packetDrop = nullptr;
     std::function<void(const std::string& msg, const std::string& uri)> infoCallback = nullptr;
 
+    // record only mode, every packet is handed over on the reader thread instead of being queued for decoding
+    std::function<void(Packet&&)> pkt_handle = nullptr;
+
+    // live packets are kept here so that playback can be paused and rewound
+    Timeshift* timeshift = nullptr;
+
+    // sees every video packet before it is queued, decoded or not
+    ActivityDetector* activity = nullptr;
+
+    // live video frames behind the master clock by more than the late threshold are dropped
+    bool drop_late_live = false;
+
+    // With a latency target the recording is fed here on the reader thread instead of after decoding, so the
+    // packets that are skipped or cleared to catch the display up still reach the file.
+    Queue<Packet>* writer_video_pkts = nullptr;
+    Queue<Packet>* writer_audio_pkts = nullptr;
+
     std::function<void(void*)> clear_callback = nullptr;
     void* player = nullptr;
     int64_t seek_pts = AV_NOPTS_VALUE;
 
 
-    Reader(const std::string& uri) : uri(uri) {
+    Reader(const std::string& uri, bool low_latency = false) : uri(uri) {
         AVDictionary* opts = nullptr;
         int timeout_us = MAX_TIMEOUT * 1000000;
 
@@ -102,12 +125,22 @@ public:
             av_dict_set_int(&opts, "rw_timeout", timeout_us, 0);
         }
 
+        if (low_latency) {
+            // packets are handed out as soon as they are read rather than held for probing and reordering
+            av_dict_set(&opts, "fflags", "nobuffer", 0);
+        }
+
         ex.ck(avformat_open_input(&fmt_ctx, uri.c_str(), nullptr, &opts), AOI);
         av_dict_free(&opts);
 
         ex.ck(avformat_find_stream_info(fmt_ctx, nullptr), AFSI);
         video_stream_index = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
         audio_stream_index = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+        for (int i = 0; i < fmt_ctx->nb_streams; i++) {
+            // data streams such as onvif metadata are never used, the demuxer can drop them early
+            if (i != video_stream_index && i != audio_stream_index)
+                fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+        }
         ex.ck((pkt = av_packet_alloc()), APA);
     }
 
@@ -135,6 +168,7 @@ public:
                 if (seek_pts < last_pts)
                     flags |= AVSEEK_FLAG_BACKWARD;
                 av_seek_frame(fmt_ctx, seek_index, seek_pts, flags);
+                clock.reset();
                 ex.eof(av_read_frame(fmt_ctx, pkt), ARF);
                 clear_callback(player);
                 seek_pts = AV_NOPTS_VALUE;
@@ -145,21 +179,43 @@ public:
             if (closed)
                 return 0;
 
-            if (writer_pkts) {
-                writer_pkts->push(Packet(pkt));
+            if (activity && pkt->stream_index == video_stream_index)
+                activity->packet(pkt);
+
+            if (pkt_handle) {
+                pkt_handle(Packet(pkt));
             }
             else {
-                if (pkt->stream_index == video_stream_index && video_pkts) {
+                if (timeshift && !timeshift_push()) {
+                    // the decoders are being fed from the timeshift buffer
+                    Packet term(pkt);
+                }
+                else if (pkt->stream_index == video_stream_index && video_pkts) {
                     last_video_pts = pkt->pts;
-                    if (packetDrop && video_pkts->full()) {
+                    record(writer_video_pkts);
+                    if (wait_for_key_frame && !(pkt->flags & AV_PKT_FLAG_KEY)) {
+                        // decoding must start clean at a key frame, the packets leading up to it are discarded
+                        Packet term(pkt);
+                    }
+                    else if (latency_target > 0 && video_pkts->full()) {
+                        // the decoder can't keep up, rather than block the network the stream restarts later
+                        wait_for_key_frame = true;
+                        if (packetDrop) packetDrop(uri);
+                        Packet term(pkt);
+                    }
+                    else if (packetDrop && video_pkts->full()) {
                         packetDrop(uri);
                     }
                     else {
+                        wait_for_key_frame = false;
+                        if (latency_target > 0)
+                            limit_latency();
                         video_pkts->push(Packet(pkt));
                     }
                 }
                 else if (pkt->stream_index == audio_stream_index && audio_pkts) {
                     last_audio_pts = pkt->pts;
+                    record(writer_audio_pkts);
                     audio_pkts->push(Packet(pkt));
                 }
                 else {
@@ -176,7 +232,9 @@ public:
                 seek_pts = AV_NOPTS_VALUE;
                 if (video_pkts) video_pkts->push(Packet(nullptr));
                 if (audio_pkts) audio_pkts->push(Packet(nullptr));
-                if (writer_pkts) writer_pkts->push(Packet(nullptr));
+                if (pkt_handle) pkt_handle(Packet(nullptr));
+                end_recording();
+                if (timeshift) timeshift->close();
             }
             else {
                 std::cout << uri << " read exception " << e.what() << std::endl;
@@ -197,14 +255,66 @@ public:
             audio_pkts->push(Packet(nullptr));
             audio_pkts = nullptr;
         }
-        if (writer_pkts) {
-            writer_pkts->push(Packet(nullptr));
-            writer_pkts = nullptr;
-        }
+        if (!closed && !terminated)
+            end_recording();
+        if (timeshift) timeshift->close();
         closed = true;
         terminated = true;
     }
 
+    void record(Queue<Packet>* writer_pkts) {
+        if (!writer_pkts) return;
+        Packet copy;
+        ex.ck(av_packet_ref(copy.pkt, pkt), APR);
+        writer_pkts->push(std::move(copy));
+    }
+
+    void end_recording() {
+        if (writer_video_pkts) writer_video_pkts->push(Packet(nullptr));
+        if (writer_audio_pkts && writer_audio_pkts != writer_video_pkts) writer_audio_pkts->push(Packet(nullptr));
+    }
+
+    // Once live video falls further behind than the target, everything queued is thrown away at the next key
+    // frame and presentation continues from there.
+    void limit_latency() {
+        int64_t rts = real_time(pkt->stream_index, pkt->pts);
+        if ((pkt->flags & AV_PKT_FLAG_KEY) && latency.backlog() > latency_target && !is_timeshifting()) {
+            clear_callback(player);
+            latency.skip_to(rts);
+            catch_ups++;
+        }
+        latency.arrived(rts);
+    }
+
+    bool timeshift_push() {
+        if (pkt->stream_index != video_stream_index && pkt->stream_index != audio_stream_index)
+            return true;
+        return timeshift->push(pkt, real_time(pkt->stream_index, pkt->pts));
+    }
+
+    bool is_timeshifting() const {
+        return timeshift && timeshift->active;
+    }
+
+    // Moves playback to a time on the stream timeline in milliseconds, a time at or beyond the live edge
+    // returns to live. The pipeline is cleared in between so no stale packets are decoded.
+    void timeshift_to(int64_t time) {
+        if (!timeshift || closed) return;
+        clock.reset();
+        if (time >= timeshift->live_edge()) {
+            if (!timeshift->active) return;
+            wait_for_key_frame = true;
+            timeshift->hold();
+            clear_callback(player);
+            timeshift->release();
+        }
+        else {
+            timeshift->hold();
+            clear_callback(player);
+            timeshift->resume_at(time);
+        }
+    }
+
     int64_t real_time(int stream_index, int64_t pts) {
         // result is returned in milliseconds
         int64_t result = -1;
@@ -235,9 +345,9 @@ public:
 
     void update_rt(int stream_index, int64_t rts) {
         if (stream_index == audio_stream_index)
-            last_audio_rts = rts;
+            clock.audio.set(rts);
         if (stream_index == video_stream_index)
-            last_video_rts = rts;
+            clock.video.set(rts);
     }
 
     int64_t duration()   const { return fmt_ctx->duration * AV_TIME_BASE / 1000000000; }
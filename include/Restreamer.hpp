@@ -0,0 +1,340 @@
+/********************************************************************
+* libavio/include/Restreamer.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef RESTREAMER_HPP
+#define RESTREAMER_HPP
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <iostream>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include "Socket.hpp"
+#include "Exception.hpp"
+#include "Compatability.hpp"
+#include "Packet.hpp"
+#include "Queue.hpp"
+#include "Reader.hpp"
+#include "Encoder.hpp"
+
+namespace avio {
+
+#define RESTREAM_IO_BUFFER_SIZE (188 * 64)
+
+// One connected viewer, with its own queue and muxer on its own thread
+struct RestreamClient {
+    socket_t sock = AVIO_INVALID_SOCKET;
+    Queue<Packet> pkts;                 // unbounded, the restreamer drops when it grows past its limit
+    bool waiting_for_key = true;        // guarded by the restreamer mutex
+    std::atomic<bool> finished { false };
+    std::atomic<bool> broken { false };
+    int64_t drops = 0;
+    std::thread* thread = nullptr;
+    AVFormatContext* fmt_ctx = nullptr;
+    bool header_written = false;
+    AVStream* video_stream = nullptr;
+    AVStream* audio_stream = nullptr;
+};
+
+// Serves the packets of one camera connection to any number of local clients as MPEG-TS over TCP, so
+// viewers open tcp://host:port instead of a session of their own on a camera that only allows a few.
+// It takes the packets from the writer path like the segmenter does, without decoding. Each client is
+// muxed on its own thread from its own queue. A client that falls behind has its queue emptied and picks
+// up again at the next key frame, the other clients and the recordings never wait for it. New clients
+// start at the most recent key frame, the packets of the current GOP are kept for them.
+
+class Restreamer {
+public:
+    Reader* reader = nullptr;
+    std::string address = "127.0.0.1";
+    int port = 0;
+    size_t max_queue = 256;             // packets queued for a client before it is dropped to the next key frame
+    size_t max_gop = 1024;
+    bool disable_audio = false;
+
+    // set when the recordings are transcoded, the clients get the encoded streams
+    Encoder* video_encoder = nullptr;
+    Encoder* audio_encoder = nullptr;
+
+    std::vector<RestreamClient*> clients;
+    std::deque<Packet> gop;
+    std::mutex mutex;
+    socket_t listener = AVIO_INVALID_SOCKET;
+    std::atomic<bool> running { false };
+    std::thread* thread = nullptr;
+    std::atomic<int64_t> drops { 0 };
+    ExceptionChecker ex;
+
+    Restreamer(Reader* reader, int port) : reader(reader), port(port) { }
+
+    ~Restreamer() {
+        stop();
+    }
+
+    void start() {
+        socket_startup();
+        try {
+            listener = listen_socket(address, port);
+        }
+        catch (const std::exception& e) {
+            socket_cleanup();
+            throw std::runtime_error(std::string("restreamer ") + e.what());
+        }
+        running = true;
+        thread = new std::thread([this] { while (accept_client()) {} });
+    }
+
+    void stop() {
+        if (!thread) return;
+        running = false;
+        shutdown_socket(listener);
+        avio_close_socket(listener);
+        listener = AVIO_INVALID_SOCKET;
+        thread->join();
+        delete thread;
+        thread = nullptr;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (RestreamClient* client : clients) {
+            // a client blocked in send is released by the shutdown
+            client->pkts.clear();
+            client->pkts.push(Packet(nullptr));
+            shutdown_socket(client->sock);
+            release(client);
+        }
+        clients.clear();
+        gop.clear();
+        socket_cleanup();
+    }
+
+    std::string url() const {
+        return "tcp://" + address + ":" + std::to_string(port);
+    }
+
+    size_t client_count() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return clients.size();
+    }
+
+    int accept_client() {
+        socket_t sock = accept(listener, nullptr, nullptr);
+        if (!running) {
+            if (sock != AVIO_INVALID_SOCKET) avio_close_socket(sock);
+            return 0;
+        }
+        if (sock == AVIO_INVALID_SOCKET)
+            return 1;
+
+        int nodelay = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&nodelay, sizeof(nodelay));
+        set_no_sigpipe(sock);
+
+        RestreamClient* client = new RestreamClient();
+        client->sock = sock;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (gop.size() && gop.size() < max_queue / 2) {
+            for (const Packet& pkt : gop)
+                client->pkts.push(Packet(pkt));
+            client->waiting_for_key = false;
+        }
+        client->thread = new std::thread([this, client] { serve(client); });
+        clients.push_back(client);
+        return 1;
+    }
+
+    // called from the writer path with every packet of the stream
+    void write(Packet& pkt) {
+        std::lock_guard<std::mutex> lock(mutex);
+        reap();
+
+        if (pkt.is_null()) {
+            for (RestreamClient* client : clients)
+                client->pkts.push(Packet(nullptr));
+            gop.clear();
+            return;
+        }
+
+        bool video = pkt.stream_index() == reader->video_stream_index;
+        bool key = reader->has_video() ? (video && pkt.is_key_frame()) : true;
+
+        if (reader->has_video()) {
+            if (key)
+                gop.clear();
+            if (gop.size() || key) {
+                if (gop.size() < max_gop)
+                    gop.push_back(Packet(pkt));
+                else
+                    gop.clear();    // too long to be worth replaying, new clients wait for the next key frame
+            }
+        }
+
+        for (RestreamClient* client : clients) {
+            if (client->pkts.size() >= max_queue) {
+                client->pkts.clear();
+                client->waiting_for_key = true;
+                client->drops++;
+                drops++;
+            }
+            if (client->waiting_for_key) {
+                if (!key) continue;
+                client->waiting_for_key = false;
+            }
+            client->pkts.push(Packet(pkt));
+        }
+    }
+
+    // clients that have gone away are removed on the next packet
+    void reap() {
+        for (auto it = clients.begin(); it != clients.end();) {
+            if ((*it)->finished) {
+                release(*it);
+                it = clients.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    void release(RestreamClient* client) {
+        if (client->thread) {
+            client->thread->join();
+            delete client->thread;
+        }
+        if (client->sock != AVIO_INVALID_SOCKET)
+            avio_close_socket(client->sock);
+        delete client;
+    }
+
+    void serve(RestreamClient* client) {
+        while (!client->broken) {
+            Packet pkt = client->pkts.pop();
+            if (pkt.is_null())
+                break;
+            try {
+                if (!client->fmt_ctx)
+                    open(client);
+                mux(client, pkt);
+            }
+            catch (const std::exception& e) {
+                std::cout << "restreamer client error: " << e.what() << std::endl;
+                break;
+            }
+        }
+        close(client);
+        // the socket stays open until the client is released, so stop can still shut it down
+        shutdown_socket(client->sock);
+        client->finished = true;
+    }
+
+    void open(RestreamClient* client) {
+        ex.ck(avformat_alloc_output_context2(&client->fmt_ctx, nullptr, "mpegts", nullptr), AAOC2);
+        unsigned char* buffer = nullptr;
+        ex.ck(buffer = (unsigned char*)av_malloc(RESTREAM_IO_BUFFER_SIZE), AM);
+        client->fmt_ctx->pb = avio_alloc_context(buffer, RESTREAM_IO_BUFFER_SIZE, 1, client, nullptr, write_socket, nullptr);
+        if (!client->fmt_ctx->pb) {
+            av_free(buffer);
+            throw std::runtime_error("avio_alloc_context has failed with NULL value");
+        }
+        client->fmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+        // every packet goes out as soon as it is muxed
+        client->fmt_ctx->flush_packets = 1;
+
+        if (reader->has_video() && !reader->disable_video) {
+            ex.ck(client->video_stream = avformat_new_stream(client->fmt_ctx, nullptr), ANS);
+            if (video_encoder)
+                video_encoder->parameters(client->video_stream->codecpar);
+            else
+                ex.ck(avcodec_parameters_copy(client->video_stream->codecpar, reader->fmt_ctx->streams[reader->video_stream_index]->codecpar), APCO);
+            client->video_stream->codecpar->codec_tag = 0;
+            client->video_stream->time_base = reader->fmt_ctx->streams[reader->video_stream_index]->time_base;
+        }
+        if (reader->has_audio() && !reader->disable_audio && !disable_audio && (audio_encoder ? audio_encoder->ready() : transport_audio(reader->audio_codec()))) {
+            ex.ck(client->audio_stream = avformat_new_stream(client->fmt_ctx, nullptr), ANS);
+            if (audio_encoder)
+                audio_encoder->parameters(client->audio_stream->codecpar);
+            else
+                ex.ck(avcodec_parameters_copy(client->audio_stream->codecpar, reader->fmt_ctx->streams[reader->audio_stream_index]->codecpar), APCO);
+            client->audio_stream->codecpar->codec_tag = 0;
+            client->audio_stream->time_base = reader->fmt_ctx->streams[reader->audio_stream_index]->time_base;
+        }
+        ex.ck(avformat_write_header(client->fmt_ctx, nullptr), AWH);
+        client->header_written = true;
+    }
+
+    // the stream timestamps are kept so the clients stay in sync with each other and with the camera
+    void mux(RestreamClient* client, Packet& pkt) {
+        AVStream* stream = nullptr;
+        if (pkt.stream_index() == reader->video_stream_index) stream = client->video_stream;
+        else if (pkt.stream_index() == reader->audio_stream_index) stream = client->audio_stream;
+        if (!stream)
+            return;
+
+        AVPacket* out = av_packet_clone(pkt.pkt);
+        if (!out)
+            throw std::runtime_error("av_packet_clone has failed with NULL value");
+        if (out->dts == AV_NOPTS_VALUE) out->dts = out->pts;
+        av_packet_rescale_ts(out, reader->fmt_ctx->streams[pkt.stream_index()]->time_base, stream->time_base);
+        out->stream_index = stream->index;
+        int ret = av_interleaved_write_frame(client->fmt_ctx, out);
+        av_packet_free(&out);
+        // a packet the muxer refuses, such as one out of order, is skipped, a closed connection ends the client
+        if (ret < 0 && client->broken)
+            ex.ck(ret, AIWF);
+    }
+
+    void close(RestreamClient* client) {
+        if (!client->fmt_ctx) return;
+        // a muxer whose header failed can't take a trailer
+        if (client->header_written && !client->broken)
+            av_write_trailer(client->fmt_ctx);
+        client->header_written = false;
+        if (client->fmt_ctx->pb) {
+            av_freep(&client->fmt_ctx->pb->buffer);
+            avio_context_free(&client->fmt_ctx->pb);
+        }
+        avformat_free_context(client->fmt_ctx);
+        client->fmt_ctx = nullptr;
+    }
+
+    static int write_socket(void* opaque, AVIO_WRITE_CONST uint8_t* buf, int buf_size) {
+        RestreamClient* client = (RestreamClient*)opaque;
+        if (client->broken || !send_all(client->sock, (const char*)buf, buf_size)) {
+            client->broken = true;
+            return AVERROR(EPIPE);
+        }
+        return buf_size;
+    }
+
+    // codecs the transport stream can carry
+    static bool transport_audio(AVCodecID codec_id) {
+        return codec_id == AV_CODEC_ID_AAC || codec_id == AV_CODEC_ID_MP2 || codec_id == AV_CODEC_ID_MP3 ||
+               codec_id == AV_CODEC_ID_AC3 || codec_id == AV_CODEC_ID_EAC3 || codec_id == AV_CODEC_ID_OPUS;
+    }
+};
+
+}
+
+#endif // RESTREAMER_HPP
@@ -0,0 +1,328 @@
+/********************************************************************
+* libavio/include/Segmenter.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef SEGMENTER_HPP
+#define SEGMENTER_HPP
+
+#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <cstring>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/dict.h>
+}
+
+#include "Exception.hpp"
+#include "Compatability.hpp"
+#include "Packet.hpp"
+#include "Reader.hpp"
+#include "Encoder.hpp"
+
+namespace avio {
+
+// Files of the live playlist kept in memory by name, the muxer replaces them as it goes
+class SegmentStore {
+public:
+    std::map<std::string, std::shared_ptr<const std::string>> files;
+    std::deque<std::string> segments;
+    size_t max_segments = 32;           // backstop in case the muxer stops deleting
+    mutable std::mutex mutex;
+
+    void put(const std::string& name, const uint8_t* data, int size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        bool added = !files.count(name);
+        files[name] = std::make_shared<const std::string>((const char*)data, size > 0 ? size : 0);
+        if (added && !is_playlist(name) && name.rfind("init", 0) != 0) {
+            segments.push_back(name);
+            while (segments.size() > max_segments) {
+                files.erase(segments.front());
+                segments.pop_front();
+            }
+        }
+    }
+
+    std::shared_ptr<const std::string> get(const std::string& name) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = files.find(name);
+        return it != files.end() ? it->second : nullptr;
+    }
+
+    void remove(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        files.erase(name);
+        for (auto it = segments.begin(); it != segments.end(); ++it) {
+            if (*it == name) {
+                segments.erase(it);
+                break;
+            }
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        files.clear();
+        segments.clear();
+    }
+
+    static bool is_playlist(const std::string& name) {
+        size_t dot = name.rfind('.');
+        std::string ext = dot == std::string::npos ? "" : name.substr(dot);
+        return ext == ".m3u8" || ext == ".mpd";
+    }
+};
+
+// A rolling HLS output fed from the packet path of the writer, so the stream is repackaged without
+// decoding and the packet data is shared by reference with the recordings. The segments are fragmented
+// mp4 and go either to a directory or, when no directory is given, to an in memory store that the muxer
+// writes through its io callbacks. The store names the files as the playlist refers to them.
+//
+// Low latency mode uses the LHLS profile of the FFmpeg dash muxer, segments are announced in the
+// playlist before they are complete and written out as short fragments, so a player that reads the
+// directory as it grows can start a segment while it is still being made. It needs the directory, the
+// in memory store only has a file once the muxer closes it.
+
+class Segmenter {
+public:
+    Reader* reader = nullptr;
+    std::string directory;
+    bool low_latency = false;
+    int segment_seconds = 2;
+    float part_seconds = 0.5f;          // fragment length in low latency mode
+    int list_size = 6;
+    bool disable_audio = false;
+
+    // set when the recordings are transcoded, the playlist carries the encoded streams
+    Encoder* video_encoder = nullptr;
+    Encoder* audio_encoder = nullptr;
+
+    SegmentStore store;
+    AVFormatContext* fmt_ctx = nullptr;
+    AVStream* video_stream = nullptr;
+    AVStream* audio_stream = nullptr;
+    AVPacket* out_pkt = nullptr;
+    int64_t video_next_pts = 0;
+    int64_t audio_next_pts = 0;
+    std::map<AVIOContext*, std::string> open_files;
+    std::mutex io_mutex;
+    ExceptionChecker ex;
+
+    Segmenter(Reader* reader, const std::string& directory = "") : reader(reader), directory(directory) {
+        ex.ck(out_pkt = av_packet_alloc(), APA);
+    }
+
+    ~Segmenter() {
+        close();
+        if (out_pkt) av_packet_free(&out_pkt);
+    }
+
+    bool in_memory() const {
+        return directory.empty();
+    }
+
+    // name of the playlist a player should load
+    std::string playlist() const {
+        return low_latency ? "master.m3u8" : "index.m3u8";
+    }
+
+    void write(Packet& pkt) {
+        if (pkt.is_null()) {
+            close();
+            return;
+        }
+        try {
+            bool video = pkt.stream_index() == reader->video_stream_index;
+            if (!fmt_ctx) {
+                // a playlist starts on a key frame, audio only streams start anywhere
+                if (reader->has_video() && !(video && pkt.is_key_frame()))
+                    return;
+                open();
+            }
+            AVStream* stream = video ? video_stream : (pkt.stream_index() == reader->audio_stream_index ? audio_stream : nullptr);
+            if (!stream)
+                return;
+
+            // renumbered from the durations the same way as the writer, so glitches in the camera clock don't reach the player
+            ex.ck(av_packet_ref(out_pkt, pkt.pkt), APR);
+            int64_t& next_pts = video ? video_next_pts : audio_next_pts;
+            out_pkt->pts = next_pts;
+            out_pkt->dts = next_pts;
+            next_pts += out_pkt->duration;
+            av_packet_rescale_ts(out_pkt, reader->fmt_ctx->streams[pkt.stream_index()]->time_base, stream->time_base);
+            out_pkt->stream_index = stream->index;
+            int ret = av_interleaved_write_frame(fmt_ctx, out_pkt);
+            av_packet_unref(out_pkt);
+            ex.ck(ret, AIWF);
+        }
+        catch (const std::exception& e) {
+            std::cout << "hls segmenter error: " << e.what() << std::endl;
+            av_packet_unref(out_pkt);
+        }
+    }
+
+    void open() {
+        std::string base = in_memory() ? "mem://" : directory + "/";
+        std::string url = base + (low_latency ? "index.mpd" : playlist());
+        AVDictionary* options = nullptr;
+
+        try {
+            ex.ck(avformat_alloc_output_context2(&fmt_ctx, nullptr, low_latency ? "dash" : "hls", url.c_str()), AAOC2);
+            if (low_latency) {
+                av_dict_set(&options, "lhls", "1", 0);
+                av_dict_set(&options, "streaming", "1", 0);
+                av_dict_set(&options, "hls_playlist", "1", 0);
+                av_dict_set(&options, "use_template", "1", 0);
+                av_dict_set(&options, "use_timeline", "0", 0);
+                av_dict_set(&options, "seg_duration", std::to_string(segment_seconds).c_str(), 0);
+                av_dict_set(&options, "frag_type", "duration", 0);
+                av_dict_set(&options, "frag_duration", std::to_string(part_seconds).c_str(), 0);
+                av_dict_set_int(&options, "window_size", list_size, 0);
+                av_dict_set_int(&options, "extra_window_size", 2, 0);
+            }
+            else {
+                av_dict_set_int(&options, "hls_time", segment_seconds, 0);
+                av_dict_set_int(&options, "hls_list_size", list_size, 0);
+                av_dict_set(&options, "hls_segment_type", "fmp4", 0);
+                av_dict_set(&options, "hls_fmp4_init_filename", "init.mp4", 0);
+                av_dict_set(&options, "hls_segment_filename", (base + "segment_%05d.m4s").c_str(), 0);
+                av_dict_set(&options, "hls_flags", "delete_segments+independent_segments", 0);
+            }
+
+            if (in_memory()) {
+                // Every file goes through the callbacks. With a method set, the muxers also delete old
+                // segments through them rather than on the file system.
+                av_dict_set(&options, "method", "PUT", 0);
+                fmt_ctx->opaque = this;
+                fmt_ctx->io_open = io_open;
+                set_io_close_compat<io_close>(fmt_ctx);
+            }
+
+            add_streams();
+            int ret = avformat_write_header(fmt_ctx, &options);
+            av_dict_free(&options);
+            ex.ck(ret, AWH);
+            video_next_pts = 0;
+            audio_next_pts = 0;
+        }
+        catch (...) {
+            av_dict_free(&options);
+            if (fmt_ctx) avformat_free_context(fmt_ctx);
+            fmt_ctx = nullptr;
+            video_stream = nullptr;
+            audio_stream = nullptr;
+            throw;
+        }
+    }
+
+    void add_streams() {
+        video_stream = nullptr;
+        audio_stream = nullptr;
+        if (reader->has_video() && !reader->disable_video) {
+            ex.ck(video_stream = avformat_new_stream(fmt_ctx, nullptr), ANS);
+            if (video_encoder)
+                video_encoder->parameters(video_stream->codecpar);
+            else
+                ex.ck(avcodec_parameters_copy(video_stream->codecpar, reader->fmt_ctx->streams[reader->video_stream_index]->codecpar), APCO);
+            video_stream->codecpar->codec_tag = 0;
+            video_stream->time_base = reader->fmt_ctx->streams[reader->video_stream_index]->time_base;
+        }
+        if (reader->has_audio() && !reader->disable_audio && !disable_audio) {
+            if (audio_encoder && !audio_encoder->ready()) {
+                // the audio encoder has not seen a frame yet, this playlist goes without sound
+            }
+            else if (!audio_encoder && reader->audio_codec() != AV_CODEC_ID_AAC) {
+                disable_audio = true;
+                std::cout << "audio codec " << reader->str_audio_codec() << " is not supported by hls, the playlist has no audio" << std::endl;
+            }
+            else {
+                ex.ck(audio_stream = avformat_new_stream(fmt_ctx, nullptr), ANS);
+                if (audio_encoder)
+                    audio_encoder->parameters(audio_stream->codecpar);
+                else
+                    ex.ck(avcodec_parameters_copy(audio_stream->codecpar, reader->fmt_ctx->streams[reader->audio_stream_index]->codecpar), APCO);
+                audio_stream->codecpar->codec_tag = 0;
+                audio_stream->time_base = reader->fmt_ctx->streams[reader->audio_stream_index]->time_base;
+            }
+        }
+        if (!video_stream && !audio_stream)
+            throw std::runtime_error("no streams for the playlist");
+    }
+
+    void close() {
+        if (!fmt_ctx) return;
+        try {
+            ex.ck(av_write_trailer(fmt_ctx), AWT);
+        }
+        catch (const std::exception& e) {
+            std::cout << "hls segmenter close error: " << e.what() << std::endl;
+        }
+        avformat_free_context(fmt_ctx);
+        fmt_ctx = nullptr;
+        video_stream = nullptr;
+        audio_stream = nullptr;
+    }
+
+    static std::string file_name(const char* url) {
+        std::string name(url ? url : "");
+        size_t slash = name.rfind('/');
+        return slash == std::string::npos ? name : name.substr(slash + 1);
+    }
+
+    // the muxer, and the mp4 muxers it runs for the segments, write into memory buffers that are stored on close
+    static int io_open(AVFormatContext* s, AVIOContext** pb, const char* url, int flags, AVDictionary** options) {
+        Segmenter* segmenter = (Segmenter*)s->opaque;
+        std::string name = file_name(url);
+        AVDictionaryEntry* method = options ? av_dict_get(*options, "method", nullptr, 0) : nullptr;
+        if (method && !strcmp(method->value, "DELETE")) {
+            segmenter->store.remove(name);
+            name.clear();
+        }
+        int ret = avio_open_dyn_buf(pb);
+        if (ret < 0)
+            return ret;
+        std::lock_guard<std::mutex> lock(segmenter->io_mutex);
+        segmenter->open_files[*pb] = name;
+        return 0;
+    }
+
+    static int io_close(AVFormatContext* s, AVIOContext* pb) {
+        Segmenter* segmenter = (Segmenter*)s->opaque;
+        std::string name;
+        {
+            std::lock_guard<std::mutex> lock(segmenter->io_mutex);
+            auto it = segmenter->open_files.find(pb);
+            if (it != segmenter->open_files.end()) {
+                name = it->second;
+                segmenter->open_files.erase(it);
+            }
+        }
+        uint8_t* data = nullptr;
+        int size = avio_close_dyn_buf(pb, &data);
+        if (!name.empty())
+            segmenter->store.put(name, data, size);
+        av_free(data);
+        return 0;
+    }
+};
+
+}
+
+#endif // SEGMENTER_HPP
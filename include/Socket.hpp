@@ -0,0 +1,130 @@
+/********************************************************************
+* libavio/include/Socket.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef SOCKET_HPP
+#define SOCKET_HPP
+
+#include <cstring>
+#include <string>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define AVIO_INVALID_SOCKET INVALID_SOCKET
+#define avio_close_socket closesocket
+#else
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int socket_t;
+#define AVIO_INVALID_SOCKET (-1)
+#define avio_close_socket ::close
+#endif
+
+namespace avio {
+
+// the small TCP servers of the library, on winsock or bsd sockets
+
+inline void socket_startup() {
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa))
+        throw std::runtime_error("winsock initialization failure");
+#endif
+}
+
+inline void socket_cleanup() {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+inline socket_t listen_socket(const std::string& address, int port) {
+    socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == AVIO_INVALID_SOCKET)
+        throw std::runtime_error("socket creation failure");
+    int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        avio_close_socket(s);
+        throw std::runtime_error("invalid address " + address);
+    }
+    if (bind(s, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(s, 16) < 0) {
+        avio_close_socket(s);
+        throw std::runtime_error("could not listen on " + address + ":" + std::to_string(port));
+    }
+    return s;
+}
+
+// wakes any thread blocked on the socket, it still has to be closed
+inline void shutdown_socket(socket_t s) {
+#ifdef _WIN32
+    shutdown(s, SD_BOTH);
+#else
+    shutdown(s, SHUT_RDWR);
+#endif
+}
+
+inline void set_socket_timeout(socket_t s, int option, int milliseconds) {
+#ifdef _WIN32
+    DWORD timeout = milliseconds;
+#else
+    timeval timeout = { milliseconds / 1000, (milliseconds % 1000) * 1000 };
+#endif
+    setsockopt(s, SOL_SOCKET, option, (const char*)&timeout, sizeof(timeout));
+}
+
+// a peer that goes away raises an error on the next send rather than a signal
+inline void set_no_sigpipe(socket_t s) {
+#ifdef SO_NOSIGPIPE
+    int no_sigpipe = 1;
+    setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, (const char*)&no_sigpipe, sizeof(no_sigpipe));
+#endif
+}
+
+inline bool send_all(socket_t s, const char* data, size_t size) {
+#ifdef MSG_NOSIGNAL
+    int flags = MSG_NOSIGNAL;
+#else
+    int flags = 0;
+#endif
+    size_t sent = 0;
+    while (sent < size) {
+        size_t chunk = size - sent < 65536 ? size - sent : 65536;
+        int n = send(s, data + sent, (int)chunk, flags);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+}
+
+#endif // SOCKET_HPP
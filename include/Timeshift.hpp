@@ -0,0 +1,331 @@
+/********************************************************************
+* libavio/include/Timeshift.hpp
+*
+* Copyright (c) 2025  Stephen Rhodes
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*********************************************************************/
+
+#ifndef TIMESHIFT_HPP
+#define TIMESHIFT_HPP
+
+#include <cstdio>
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include "Exception.hpp"
+#include "Packet.hpp"
+#include "Queue.hpp"
+#include "Cache.hpp"
+
+namespace avio {
+
+// Every demuxed packet of a live stream passes through the timeshift buffer. The most recent packets are
+// held in memory, older ones are spilled to segment files on disk and whole segments are discarded once
+// they fall out of the time window. While the viewer is live the buffer only keeps packets, when paused or
+// rewound the decoders are fed from a cursor in the buffer instead of from the reader, and ingest carries on.
+
+struct TimeshiftRecord {
+    int64_t pts;
+    int64_t dts;
+    int64_t duration;
+    int32_t stream_index;
+    int32_t flags;
+    int32_t size;
+};
+
+struct TimeshiftEntry {
+    uint64_t seq;
+    int64_t time;
+    int64_t offset;
+    bool key;
+};
+
+struct TimeshiftSegment {
+    FILE* fp = nullptr;
+    int64_t size = 0;
+    std::vector<TimeshiftEntry> index;
+    bool sealed = false;                // packets after it were lost, the next spill starts another segment
+
+    int64_t first_time() const { return index.size() ? index.front().time : -1; }
+    int64_t last_time()  const { return index.size() ? index.back().time : -1; }
+};
+
+class Timeshift {
+public:
+    int64_t window;                     // total span kept, in milliseconds
+    int64_t ram_window;                 // span kept in memory before spilling to disk
+    int64_t segment_span = 60000;
+    std::string dir;                    // segment files are anonymous temporary files when empty
+    int key_stream;                     // index of the stream whose key frames are the entry points
+
+    Cache ram;
+    std::deque<TimeshiftSegment> segments;
+
+    // playback state
+    bool active = false;                // the decoders are fed from the buffer
+    bool ready = false;                 // the cursor has been placed and packets may flow
+    uint64_t cursor = 0;
+    int64_t position = -1;              // time of the last packet handed out
+    int64_t resume_time = -1;           // decoded output before this time is not presented
+    uint64_t generation = 0;
+    bool closed = false;
+
+    // live packets are passed on to the recorder from here, so recording is unaffected by playback
+    Queue<Packet>* writer_pkts = nullptr;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    ExceptionChecker ex;
+
+    Timeshift(int key_stream, int window_in_seconds, int ram_window_in_seconds, const std::string& dir = "")
+            : window((int64_t)window_in_seconds * 1000), dir(dir), key_stream(key_stream) {
+        ram_window = std::min(window, (int64_t)ram_window_in_seconds * 1000);
+        ram.key_stream = key_stream;
+    }
+
+    ~Timeshift() {
+        for (TimeshiftSegment& segment : segments)
+            if (segment.fp) fclose(segment.fp);
+    }
+
+    // Called on the reader thread with every live packet. The buffer takes its own reference, the return
+    // value tells the reader whether to still route the packet to the decoders.
+    bool push(AVPacket* pkt, int64_t time) {
+        if (writer_pkts) {
+            Packet copy;
+            ex.ck(av_packet_ref(copy.pkt, pkt), APR);
+            writer_pkts->push(std::move(copy));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        ram.push(pkt, time, true);
+        try {
+            while (window > ram_window && ram.duration() > ram_window)
+                spill();
+            while (segments.size() && segments.front().last_time() < ram.back_time() - window) {
+                if (segments.front().fp) fclose(segments.front().fp);
+                segments.pop_front();
+            }
+            if (window <= ram_window)
+                ram.trim_before(ram.back_time() - window);
+        }
+        catch (const std::exception& e) {
+            // without disk space the buffer falls back to what fits in memory
+            std::cout << "timeshift spill error: " << e.what() << std::endl;
+            uint64_t first_seq = ram.first_seq;
+            ram.trim_before(ram.back_time() - ram_window);
+            // the index of a segment is addressed by seq, it can't be continued across the trimmed packets
+            if (ram.first_seq != first_seq && segments.size())
+                segments.back().sealed = true;
+        }
+        cv.notify_all();
+        return !active;
+    }
+
+    void spill() {
+        AVPacket* pkt = ram.front();
+        int64_t time = ram.front_time();
+        bool key = (pkt->flags & AV_PKT_FLAG_KEY) && (key_stream < 0 || pkt->stream_index == key_stream);
+        // segments begin on a key frame so that dropping the oldest one leaves a decodable start
+        if (segments.empty() || segments.back().sealed || (key && time - segments.back().first_time() >= segment_span))
+            open_segment();
+
+        TimeshiftSegment& segment = segments.back();
+        TimeshiftRecord record = { pkt->pts, pkt->dts, pkt->duration, pkt->stream_index, pkt->flags, pkt->size };
+        if (seek_file(segment.fp, segment.size)) throw std::runtime_error("segment seek failed");
+        if (fwrite(&record, sizeof(record), 1, segment.fp) != 1) throw std::runtime_error("segment write failed");
+        if (pkt->size && fwrite(pkt->data, 1, pkt->size, segment.fp) != pkt->size) throw std::runtime_error("segment write failed");
+        segment.index.push_back({ ram.first_seq, time, segment.size, key });
+        segment.size += sizeof(record) + pkt->size;
+        ram.pop_front();
+    }
+
+    void open_segment() {
+        TimeshiftSegment segment;
+        if (dir.empty()) {
+            segment.fp = tmpfile();
+        }
+        else {
+            std::stringstream str;
+            str << dir << "/timeshift_" << (void*)this << "_" << ram.first_seq << ".seg";
+            segment.fp = fopen(str.str().c_str(), "w+b");
+            // the name is not needed once open, the file goes away when it is closed
+            if (segment.fp) remove(str.str().c_str());
+        }
+        if (!segment.fp) throw std::runtime_error("unable to create timeshift segment");
+        segments.push_back(segment);
+    }
+
+    void read_segment(TimeshiftSegment& segment, const TimeshiftEntry& entry, Packet& out) {
+        TimeshiftRecord record;
+        if (seek_file(segment.fp, entry.offset)) throw std::runtime_error("segment seek failed");
+        if (fread(&record, sizeof(record), 1, segment.fp) != 1) throw std::runtime_error("segment read failed");
+        ex.ck(av_new_packet(out.pkt, record.size), ANP);
+        if (record.size && fread(out.pkt->data, 1, record.size, segment.fp) != record.size) throw std::runtime_error("segment read failed");
+        out.pkt->pts = record.pts;
+        out.pkt->dts = record.dts;
+        out.pkt->duration = record.duration;
+        out.pkt->stream_index = record.stream_index;
+        out.pkt->flags = record.flags;
+    }
+
+    static int seek_file(FILE* fp, int64_t offset) {
+#ifdef _WIN32
+        return _fseeki64(fp, offset, SEEK_SET);
+#else
+        return fseeko(fp, offset, SEEK_SET);
+#endif
+    }
+
+    uint64_t oldest_seq() const {
+        for (const TimeshiftSegment& segment : segments)
+            if (segment.index.size()) return segment.index.front().seq;
+        return ram.first_seq;
+    }
+
+    int64_t oldest_time() const {
+        for (const TimeshiftSegment& segment : segments)
+            if (segment.index.size()) return segment.first_time();
+        return ram.front_time();
+    }
+
+    int64_t live_time() const {
+        return ram.back_time();
+    }
+
+    // sequence number of the last entry point at or before time, or the earliest one
+    uint64_t key_before(int64_t time) const {
+        uint64_t result = UINT64_MAX;
+        for (const TimeshiftSegment& segment : segments) {
+            for (const TimeshiftEntry& entry : segment.index) {
+                if (!entry.key) continue;
+                if (entry.time > time && result != UINT64_MAX) return result;
+                result = entry.seq;
+            }
+        }
+        for (uint64_t seq : ram.key_frames) {
+            if (ram.time_of(seq) > time && result != UINT64_MAX) return result;
+            result = seq;
+        }
+        return result == UINT64_MAX ? ram.first_seq : result;
+    }
+
+    // Decoding is switched over to the buffer but nothing is handed out until the cursor is placed, this
+    // leaves time to clear the pipeline of the packets that were already on their way.
+    void hold() {
+        std::lock_guard<std::mutex> lock(mutex);
+        active = true;
+        ready = false;
+        generation++;
+    }
+
+    void resume_at(int64_t time) {
+        std::lock_guard<std::mutex> lock(mutex);
+        time = std::max(time, oldest_time());
+        cursor = key_before(time);
+        resume_time = time;
+        position = time;
+        ready = true;
+        cv.notify_all();
+    }
+
+    void release() {
+        std::lock_guard<std::mutex> lock(mutex);
+        active = false;
+        ready = false;
+        resume_time = -1;
+        generation++;
+        cv.notify_all();
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed) return;
+        closed = true;
+        if (writer_pkts) writer_pkts->push(Packet(nullptr));
+        cv.notify_all();
+    }
+
+    // Called by the playback thread, returns 1 with the next packet, 0 when the stream has closed and -1
+    // when playback has caught up with the live edge.
+    int next(Packet& out, uint64_t& gen) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return closed || (active && ready); });
+        if (closed) return 0;
+        gen = generation;
+
+        // the cursor fell out of the window while paused, continue from the oldest entry point
+        if (cursor < oldest_seq())
+            cursor = key_before(oldest_time());
+        if (cursor >= ram.end_seq())
+            return -1;
+
+        try {
+            if (cursor >= ram.first_seq) {
+                ex.ck(av_packet_ref(out.pkt, ram.at(cursor)), APR);
+                position = ram.time_of(cursor);
+            }
+            else {
+                for (TimeshiftSegment& segment : segments) {
+                    if (segment.index.empty() || segment.index.back().seq < cursor) continue;
+                    if (cursor < segment.index.front().seq)
+                        // lost to a spill error, playback carries on after the gap
+                        cursor = segment.index.front().seq;
+                    const TimeshiftEntry& entry = segment.index[cursor - segment.index.front().seq];
+                    read_segment(segment, entry, out);
+                    position = entry.time;
+                    break;
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            std::cout << "timeshift read error: " << e.what() << std::endl;
+        }
+        cursor++;
+        return 1;
+    }
+
+    int64_t live_edge() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return live_time();
+    }
+
+    // earliest time that can be played back
+    int64_t earliest() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return oldest_time();
+    }
+
+    // how far playback is behind the live edge in milliseconds
+    int64_t delay() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return active ? std::max((int64_t)0, live_time() - position) : 0;
+    }
+
+    bool is_current(uint64_t gen) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return active && ready && gen == generation;
+    }
+};
+
+}
+
+#endif // TIMESHIFT_HPP
@@ -22,6 +22,8 @@
 
 #include <map>
 #include <mutex>
+#include <thread>
+#include <atomic>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -32,6 +34,10 @@ extern "C" {
 #include "Packet.hpp"
 #include "Reader.hpp"
 #include "Queue.hpp"
+#include "Cache.hpp"
+#include "AsyncFile.hpp"
+#include "Catalog.hpp"
+#include "Encoder.hpp"
 
 namespace avio {
 
@@ -40,29 +46,86 @@ public:
     Reader* reader;
     std::string filename;
     AVFormatContext* fmt_ctx = nullptr;
-    AVCodecContext* video_ctx = nullptr;
-    AVCodecContext* audio_ctx = nullptr;
     AVStream* video_stream = nullptr;
     AVStream* audio_stream = nullptr;
     int64_t video_next_pts;
     int64_t audio_next_pts;
     Queue<Packet>* input = nullptr;
-    Queue<Packet> video_cache;
-    Queue<Packet> audio_cache;
+    Cache video_cache;
+    Cache audio_cache;
+    AVPacket* out_pkt = nullptr;
     bool disable_video = false;
     bool disable_audio = false;
+    bool async_io = false;
+    size_t io_block_size = 1 << 20;
+    AsyncFile* async_file = nullptr;
+    IOStats io_stats;
+    bool fragmented = false;
+    int segment_duration_in_seconds = 0;
+    int cache_size_in_seconds;
+
+    // the writer created by the Player follows reader->recording, additional outputs have their own switch
+    bool primary = true;
+    bool recording = false;
+
+    // gapless rollover state
+    AVFormatContext* next_ctx = nullptr;
+    AsyncFile* next_file = nullptr;
+    std::string next_filename;
+    std::atomic<bool> next_ready { false };
+    std::thread* next_thread = nullptr;
+    std::thread* closer = nullptr;
+    std::mutex next_mutex;
+
+    // optional index of the files written, not owned by the writer
+    Catalog* catalog = nullptr;
+    bool cataloged = false;
+    int64_t wall_offset = 0;        // wall clock minus stream time, in milliseconds
+    int64_t last_wall = -1;
+    int64_t last_key_wall = -1;
+    // transcode mode, the streams are written from these encoders instead of being copied
+    Encoder* video_encoder = nullptr;
+    Encoder* audio_encoder = nullptr;
+
     //std::map<std::string, std::string> metadata;
     ExceptionChecker ex;
 
-    Writer(Reader* reader) : reader(reader) { }
+    Writer(Reader* reader) : reader(reader), cache_size_in_seconds(reader->cache_size_in_seconds) {
+        ex.ck((out_pkt = av_packet_alloc()), APA);
+    }
 
     ~Writer() {
         close();
+        if (closer) {
+            closer->join();
+            delete closer;
+        }
+        if (out_pkt) av_packet_free(&out_pkt);
     }
 
     void open(const std::string& base_filename /*, std::map<std::string, std::string>& metadata*/) {
+        fmt_ctx = create(base_filename, filename, &async_file);
+        assign_streams();
+    }
+
+    // builds a complete output with its header written, this can run on a background thread
+    AVFormatContext* create(const std::string& base_filename, std::string& filename, AsyncFile** file) {
+        AVFormatContext* fmt_ctx = nullptr;
+        AVCodecContext* video_ctx = nullptr;
+        AVCodecContext* audio_ctx = nullptr;
+        AVStream* video_stream = nullptr;
+        AVStream* audio_stream = nullptr;
+
+        // an audio encoder that is late only costs this file its sound, the next one tries again
+        bool with_audio = !disable_audio;
+        if ((video_encoder || audio_encoder) && !wait_for_encoders())
+            with_audio = false;
+
         std::string extension = ".mp4";
-        if (reader->has_audio() && !disable_audio) {
+        if (audio_encoder) {
+            // transcoded audio is always aac
+        }
+        else if (reader->has_audio() && !disable_audio) {
             if      (reader->audio_codec() == AV_CODEC_ID_PCM_MULAW)  extension = ".mov";
             else if (reader->audio_codec() == AV_CODEC_ID_PCM_ALAW)   extension = ".mov";
             else if (reader->audio_codec() == AV_CODEC_ID_AAC)        extension = ".mp4";
@@ -74,10 +137,33 @@ public:
                 std::cout << str.str() << std::endl;
             }
         }
-        filename = base_filename + extension;
+        AVDictionary* options = nullptr;
+        if (fragmented) {
+            // fragments are flushed at every key frame, so the file is playable while it is still being written
+            // and a crash loses at most the current fragment
+            av_dict_set(&options, "movflags", "+frag_keyframe+empty_moov+default_base_moof", 0);
+        }
 
-        ex.ck(avformat_alloc_output_context2(&fmt_ctx, nullptr, nullptr, filename.c_str()), AAOC2);
-        if (reader->video_stream_index >= 0 && !disable_video) {
+        if (segment_duration_in_seconds > 0) {
+            // the segment muxer rolls over to a new numbered file at the first key frame past each interval
+            filename = base_filename + "_%05d" + extension;
+            ex.ck(avformat_alloc_output_context2(&fmt_ctx, nullptr, "segment", filename.c_str()), AAOC2);
+            av_dict_set_int(&options, "segment_time", segment_duration_in_seconds, 0);
+            av_dict_set(&options, "segment_format", extension.substr(1).c_str(), 0);
+            av_dict_set_int(&options, "reset_timestamps", 1, 0);
+            if (fragmented)
+                av_dict_set(&options, "segment_format_options", "movflags=+frag_keyframe+empty_moov+default_base_moof", 0);
+        }
+        else {
+            filename = base_filename + extension;
+            ex.ck(avformat_alloc_output_context2(&fmt_ctx, nullptr, nullptr, filename.c_str()), AAOC2);
+        }
+        if (reader->video_stream_index >= 0 && !disable_video && video_encoder) {
+            ex.ck(video_stream = avformat_new_stream(fmt_ctx, nullptr), ANS);
+            video_encoder->parameters(video_stream->codecpar);
+            video_stream->time_base = reader->fmt_ctx->streams[reader->video_stream_index]->time_base;
+        }
+        else if (reader->video_stream_index >= 0 && !disable_video) {
             AVStream* stream = reader->fmt_ctx->streams[reader->video_stream_index];
             const AVCodec* encoder = avcodec_find_encoder(stream->codecpar->codec_id);
             if (!encoder) throw std::runtime_error("writer constructor could not find encoder for video stream");
@@ -87,7 +173,12 @@ public:
             ex.ck(avcodec_parameters_from_context(video_stream->codecpar, video_ctx), APFC);
             video_stream->time_base = reader->fmt_ctx->streams[reader->video_stream_index]->time_base;
         }
-        if (reader->audio_stream_index >= 0 && !disable_audio) {
+        if (reader->audio_stream_index >= 0 && with_audio && audio_encoder) {
+            ex.ck(audio_stream = avformat_new_stream(fmt_ctx, nullptr), ANS);
+            audio_encoder->parameters(audio_stream->codecpar);
+            audio_stream->time_base = reader->fmt_ctx->streams[reader->audio_stream_index]->time_base;
+        }
+        else if (reader->audio_stream_index >= 0 && with_audio) {
             AVStream* stream = reader->fmt_ctx->streams[reader->audio_stream_index];
             const AVCodec* encoder = avcodec_find_encoder(stream->codecpar->codec_id);
             if (!encoder) throw std::runtime_error("writer constructor could not find encoder for audio stream");
@@ -97,9 +188,23 @@ public:
             ex.ck(avcodec_parameters_from_context(audio_stream->codecpar, audio_ctx), APFC);
             audio_stream->time_base = reader->fmt_ctx->streams[reader->audio_stream_index]->time_base;
         }
+        // the codec contexts only served to carry the stream parameters over
+        if (video_ctx) avcodec_free_context(&video_ctx);
+        if (audio_ctx) avcodec_free_context(&audio_ctx);
 
 
-        ex.ck(avio_open(&fmt_ctx->pb, filename.c_str(), AVIO_FLAG_WRITE), AO);
+        if (fmt_ctx->oformat->flags & AVFMT_NOFILE) {
+            // the segment muxer opens each of its files itself
+        }
+        else if (async_io) {
+            // the muxer writes into large blocks that are handed to the shared disk thread
+            *file = new AsyncFile(filename, &io_stats, io_block_size);
+            fmt_ctx->pb = (*file)->pb;
+            fmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+        }
+        else {
+            ex.ck(avio_open(&fmt_ctx->pb, filename.c_str(), AVIO_FLAG_WRITE), AO);
+        }
         /*
         std::map<std::string, std::string>::iterator it;
         for(it = metadata.begin(); it != metadata.end(); ++it)
@@ -108,12 +213,119 @@ public:
         av_dict_set(&options, "movflags", "use_metadata_tags", 0);
         ex.ck(avformat_write_header(fmt_ctx, &options), AWH);
         */
-        ex.ck(avformat_write_header(fmt_ctx, nullptr), AWH);
+        int ret = avformat_write_header(fmt_ctx, &options);
+        av_dict_free(&options);
+        ex.ck(ret, AWH);
+        return fmt_ctx;
+    }
 
+    // The encoders are opened by their first frame. Video packets only arrive once the video encoder is
+    // open, but a recording started at the beginning of the stream may get ahead of the audio. Returns
+    // false when the file has to go without audio.
+    bool wait_for_encoders() {
+        for (int i = 0; i < 200; i++) {
+            if ((!video_encoder || video_encoder->ready()) && (!audio_encoder || audio_encoder->ready()))
+                return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (audio_encoder && !audio_encoder->ready() && !disable_audio) {
+            std::cout << "audio encoder did not start, the file is recorded without audio" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void assign_streams() {
+        // streams are created in the order video, audio
+        int index = 0;
+        video_stream = (reader->video_stream_index >= 0 && !disable_video) ? fmt_ctx->streams[index++] : nullptr;
+        // a file made while the audio encoder was not ready has no audio stream
+        audio_stream = (reader->audio_stream_index >= 0 && !disable_audio && index < (int)fmt_ctx->nb_streams) ? fmt_ctx->streams[index++] : nullptr;
         video_next_pts = 0;
         audio_next_pts = 0;
     }
 
+    void rollover(const std::string& base_filename) {
+        std::lock_guard<std::mutex> lock(next_mutex);
+        if (!fmt_ctx) {
+            filename = base_filename;
+            return;
+        }
+        if (next_thread && !next_ready) {
+            // an earlier attempt has failed to open its file, or is still opening it
+            next_thread->join();
+            delete next_thread;
+            next_thread = nullptr;
+        }
+        // a file that is open and waiting for its switch point is never replaced
+        if (next_ready || next_ctx) {
+            std::cout << "rollover to " << base_filename << " ignored, the previous rollover is still pending" << std::endl;
+            return;
+        }
+        // the next file is opened off the packet path, write() switches over to it at the next key frame
+        next_thread = new std::thread([this, base_filename] {
+            try {
+                next_ctx = create(base_filename, next_filename, &next_file);
+                next_ready = true;
+            }
+            catch (const std::exception& e) {
+                std::cout << "error opening " << base_filename << " for rollover: " << e.what() << std::endl;
+            }
+        });
+    }
+
+    bool is_switch_point(const Packet& pkt) const {
+        if (reader->has_video() && !disable_video)
+            return pkt.stream_index() == reader->video_stream_index && pkt.is_key_frame();
+        return pkt.stream_index() == reader->audio_stream_index;
+    }
+
+    void switch_output() {
+        std::lock_guard<std::mutex> lock(next_mutex);
+        if (next_thread) {
+            next_thread->join();
+            delete next_thread;
+            next_thread = nullptr;
+        }
+        next_ready = false;
+
+        // the trailer of the finished file is written in the background so the packet flow never pauses
+        if (closer) {
+            closer->join();
+            delete closer;
+        }
+        AVFormatContext* old_ctx = fmt_ctx;
+        AsyncFile* old_file = async_file;
+        std::string old_filename = filename;
+        int64_t end = last_wall;
+        closer = new std::thread([this, old_ctx, old_file, old_filename, end] {
+            close_output(old_ctx, old_file);
+            if (catalog && end >= 0) catalog->end(old_filename, end);
+        });
+        cataloged = false;
+        last_wall = -1;
+
+        fmt_ctx = next_ctx;
+        async_file = next_file;
+        filename = next_filename;
+        next_ctx = nullptr;
+        next_file = nullptr;
+        assign_streams();
+    }
+
+    void discard_next() {
+        std::lock_guard<std::mutex> lock(next_mutex);
+        if (next_thread) {
+            next_thread->join();
+            delete next_thread;
+            next_thread = nullptr;
+        }
+        if (next_ctx) close_output(next_ctx, next_file);
+        next_ctx = nullptr;
+        next_file = nullptr;
+        next_ready = false;
+    }
+
     void adjust_pts(AVPacket* pkt) {
         if (pkt->stream_index == reader->video_stream_index) {
             pkt->stream_index = video_stream->index;
@@ -132,7 +344,9 @@ public:
     void write_packet(AVPacket* pkt) {
         if (!pkt) return;
         try {
-            if (((pkt->stream_index == reader->video_stream_index) && !disable_video) || ((pkt->stream_index == reader->audio_stream_index) && !disable_audio)) {
+            if (((pkt->stream_index == reader->video_stream_index) && !disable_video) || ((pkt->stream_index == reader->audio_stream_index) && audio_stream)) {
+                // the files of a segmented output are named by the segment muxer, they can't be indexed here
+                if (catalog && segment_duration_in_seconds <= 0) index_packet(pkt);
                 adjust_pts(pkt);
                 ex.ck(av_interleaved_write_frame(fmt_ctx, pkt), AIWF);
             }
@@ -140,70 +354,72 @@ public:
         catch (const std::exception& e) {
             std::cout << "packet write exception: " << e.what() << std::endl;
         }
+        av_packet_unref(pkt);
     }
 
-    void write_cache() {
-        size_t video_ptr = 0;
-        size_t audio_ptr = 0;
-
-        while (video_ptr < video_cache.size() && audio_ptr < audio_cache.size()) {
-            int64_t audio_rt = reader->real_time(reader->audio_stream_index, audio_cache.at(audio_ptr)->pts());
-            int64_t video_rt = reader->real_time(reader->video_stream_index, video_cache.at(video_ptr)->pts());
-            if (video_rt > audio_rt && audio_rt != -1) {
-                while (audio_ptr < audio_cache.size()) {
-                    if (reader->real_time(reader->audio_stream_index, audio_cache.at(audio_ptr)->pts()) > video_rt)
-                        break;
-                    Packet tmp = *(audio_cache.at(audio_ptr));
-                    write_packet(tmp.pkt);
-                    audio_ptr++;
-                }
-            }
-            else {
-                if (video_ptr < video_cache.size()) {
-                    Packet tmp = *(video_cache.at(video_ptr));
-                    write_packet(tmp.pkt);
-                    video_ptr++;
-                }
-                else {
-                    while (audio_ptr < audio_cache.size()) {
-                        Packet tmp = *(audio_cache.at(audio_ptr));
-                        write_packet(tmp.pkt);
-                        audio_ptr++;
-                    }
-                }
-            }
+    // Records the start of the file and its key frames in the catalog. The byte offset is the position of
+    // the muxer when the key frame is handed over, packets still held for interleaving make it approximate,
+    // it is a place to begin reading rather than an exact boundary.
+    void index_packet(AVPacket* pkt) {
+        int64_t stream_time = reader->real_time(pkt->stream_index, pkt->pts);
+        if (stream_time < 0) return;
+        int64_t wall = stream_time + wall_offset;
+        if (!cataloged) {
+            catalog->start(filename, reader->uri, wall);
+            cataloged = true;
+            last_key_wall = -1;
         }
-
-        if (video_cache.size() && !audio_cache.size()) {
-            while (video_ptr < video_cache.size()) {
-                Packet tmp = *(video_cache.at(video_ptr));
-                write_packet(tmp.pkt);
-                video_ptr++;
-            }
+        bool video = pkt->stream_index == reader->video_stream_index;
+        bool key = video ? (pkt->flags & AV_PKT_FLAG_KEY) : (!video_stream && wall - last_key_wall >= 1000);
+        if (key) {
+            // position of the key frame on the file's own timeline, which starts at zero
+            int64_t next_pts = video ? video_next_pts : audio_next_pts;
+            int64_t media = 1000 * av_q2d(reader->fmt_ctx->streams[pkt->stream_index]->time_base) * next_pts;
+            catalog->key_frame(filename, wall, media, fmt_ctx->pb ? avio_tell(fmt_ctx->pb) : -1);
+            last_key_wall = wall;
         }
+        if (wall > last_wall) last_wall = wall;
+    }
 
-        if (!video_cache.size() && audio_cache.size()) {
-            while (audio_ptr < audio_cache.size()) {
-                Packet tmp = *(audio_cache.at(audio_ptr));
-                write_packet(tmp.pkt);
-                audio_ptr++;
-            }
+    void write_cache() {
+        // the cached packets are interleaved by real time and their references moved into the file
+        while (video_cache.size() || audio_cache.size()) {
+            bool audio_first = !video_cache.size() ||
+                    (audio_cache.size() && audio_cache.front_time() < video_cache.front_time());
+            Cache& cache = audio_first ? audio_cache : video_cache;
+            write_packet(cache.front());
+            cache.pop_front();
         }
     }
 
     int write() {
-        Packet pkt = input->pop();
+        return write(input->pop());
+    }
+
+    int write(Packet&& pkt) {
+        return write(pkt, false);
+    }
+
+    // a shared packet is left intact for the other writers fed from the same stream
+    int write(Packet& pkt, bool shared) {
         //if (reader->recording && !reader->closed && !reader->terminated && !pkt.is_null()) {
         // there's an issue here with how the stream closes, either video or audio could send
         // a null packet first when using post decode mode
-        if (reader->recording && !pkt.is_null()) {
+        if (is_recording() && !pkt.is_null()) {
             try {
                 if (!fmt_ctx) {
+                    wall_offset = Catalog::now() - reader->real_time(pkt.stream_index(), pkt.pts());
+                    last_wall = -1;
+                    cataloged = false;
                     open(filename);
                     write_cache();
                 }
-                Packet tmp = pkt;
-                write_packet(tmp.pkt);
+                else if (next_ready && is_switch_point(pkt)) {
+                    switch_output();
+                }
+                // the file gets its own reference to the packet data, the original goes on to the cache
+                if (av_packet_ref(out_pkt, pkt.pkt) >= 0)
+                    write_packet(out_pkt);
             }
             catch (const std::exception& e) {
                 std::cout << "error writing to " << filename << ": " << e.what() << std::endl;
@@ -217,96 +433,65 @@ public:
             return 0;
         }
 
-        push_cache_pkt(std::move(pkt));
+        push_cache_pkt(pkt, shared);
         return 1;        
     }
 
-    void push_cache_pkt(Packet&& pkt) {
+    bool is_recording() const {
+        return primary ? reader->recording : recording;
+    }
+
+    void push_cache_pkt(Packet& pkt, bool shared) {
         // The cache preserves recent packets so that when recording starts, the packets during a time interval prior to
         // start of recording are preserved. This insures that moments leading up to the alarm are recorded as well. For
         // continuously recording streams, this guarantees that there is some overlap during the transition between files.
+        int64_t window = cache_size_in_seconds * 1000;
         if (pkt.stream_index() == reader->video_stream_index) {
+            bool key_frame = pkt.is_key_frame();
+            video_cache.push(pkt.pkt, reader->real_time(reader->video_stream_index, pkt.pts()), shared);
             // first pkt of video cache must always be keyframe, so only trim when a new keyframe enters the cache
-            if (pkt.is_key_frame()) {
-                int64_t stream_time = reader->real_time(reader->video_stream_index, pkt.pts());
-                size_t search_index = video_cache.size() - 1;
-                size_t key_frame_index = video_cache.find_last_key_frame(search_index);
-                if (key_frame_index != SIZE_MAX) {
-                    // search the cache for keyframes starting from the back until the trimmed cache duration is approx target
-                    int64_t key_frame_time = reader->real_time(reader->video_stream_index, video_cache.at(key_frame_index)->pts());
-                    int64_t cache_duration = stream_time - key_frame_time;
-                    while ((cache_duration < reader->cache_size_in_seconds * 1000) && (key_frame_index > 0)) {
-                        key_frame_index = video_cache.find_last_key_frame(search_index);
-                        if (key_frame_index == SIZE_MAX)
-                            break;
-                        key_frame_time = reader->real_time(reader->video_stream_index, video_cache.at(key_frame_index)->pts());
-                        cache_duration = stream_time - key_frame_time;
-                        if (key_frame_index > 0)
-                            search_index = key_frame_index - 1;
-                    }
-                    // match audio cache duration to video cache duration
-                    if (reader->has_audio()) {
-                        int64_t audio_pts = reader->pts_from_real_time(reader->audio_stream_index, key_frame_time);
-                        size_t audio_index = audio_cache.find_pts(audio_pts);
-                        if (audio_index != SIZE_MAX) {
-                            audio_cache.erase_front(audio_index);
-                        }
-                    }
-                    // trim video cache
-                    if (key_frame_index != SIZE_MAX) {
-                        video_cache.erase_front(key_frame_index);
-                    }
-                    // guarantee that the first video pkt in cache is a key frame
-                    key_frame_index = video_cache.find_first_key_frame(0);
-                    if (key_frame_index > 0 && key_frame_index != SIZE_MAX) {
-                        if (reader->has_audio()) {
-                            key_frame_time = reader->real_time(reader->video_stream_index, video_cache.at(key_frame_index)->pts());
-                            int64_t audio_pts = reader->pts_from_real_time(reader->audio_stream_index, key_frame_time);
-                            size_t audio_index = audio_cache.find_pts(audio_pts);
-                            if (audio_index != SIZE_MAX)
-                                audio_cache.erase_front(audio_index);
-                        }
-                        video_cache.erase_front(key_frame_index);
-                    }
-                }
+            if (key_frame) {
+                video_cache.trim_to_key_frames(window);
+                // match audio cache duration to video cache duration
+                if (reader->has_audio())
+                    audio_cache.trim_before(video_cache.front_time());
             }
-            video_cache.push(std::move(pkt));
         }
         else if (pkt.stream_index() == reader->audio_stream_index) {
+            int64_t stream_time = reader->real_time(reader->audio_stream_index, pkt.pts());
+            audio_cache.push(pkt.pkt, stream_time, shared);
             // only trim the audio cache here if there is no video cache
-            if (!reader->has_video() && audio_cache.size()) {
-                int64_t stream_time = reader->real_time(reader->audio_stream_index, pkt.pts());
-                int64_t cache_start_time = reader->real_time(reader->audio_stream_index, audio_cache.at(0)->pts());
-                while ((stream_time - cache_start_time) > reader->cache_size_in_seconds * 1000) {
-                    audio_cache.erase_front(1);
-                    cache_start_time = reader->real_time(reader->audio_stream_index, audio_cache.at(0)->pts());
-                } 
-            }
-            audio_cache.push(std::move(pkt));
+            if (!reader->has_video())
+                audio_cache.trim_before(stream_time - window);
         }
     }
 
     void close() {
-        if (video_ctx) {
-            avcodec_free_context(&video_ctx);
-            video_ctx = nullptr;
-        }
-        if (audio_ctx) {
-            avcodec_free_context(&audio_ctx);
-            audio_ctx = nullptr;
-        }
+        discard_next();
         if (fmt_ctx) {
-            try {
-                avio_flush(fmt_ctx->pb);
-                ex.ck(av_write_trailer(fmt_ctx), AWT);
+            close_output(fmt_ctx, async_file);
+            fmt_ctx = nullptr;
+            async_file = nullptr;
+            if (catalog && cataloged && last_wall >= 0) catalog->end(filename, last_wall);
+            cataloged = false;
+        }
+    }
+
+    void close_output(AVFormatContext* fmt_ctx, AsyncFile* async_file) {
+        try {
+            if (fmt_ctx->pb) avio_flush(fmt_ctx->pb);
+            ex.ck(av_write_trailer(fmt_ctx), AWT);
+            if (!async_file)
                 ex.ck(avio_closep(&fmt_ctx->pb), ACP);
-                avformat_free_context(fmt_ctx);
-                fmt_ctx = nullptr;
-            }
-            catch (const std::exception& e) {
-                std::cout << "writer close exception: " << e.what() << std::endl;
-            }
         }
+        catch (const std::exception& e) {
+            std::cout << "writer close exception: " << e.what() << std::endl;
+        }
+        if (async_file) {
+            delete async_file;
+            fmt_ctx->pb = nullptr;
+        }
+        avformat_free_context(fmt_ctx);
     }
 };
 
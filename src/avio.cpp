@@ -20,10 +20,16 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/functional.h>
+#include <optional>
 #include "Player.hpp"
 #include "Reader.hpp"
 #include "Frame.hpp"
 #include "Audio.hpp"
+#include "Catalog.hpp"
+#include "Exporter.hpp"
+#include "FrameReader.hpp"
+#include "FrameExtractor.hpp"
+#include "BatchDecoder.hpp"
 
 namespace py = pybind11;
 
@@ -39,14 +45,28 @@ PYBIND11_MODULE(avio, m)
         .def("play", &Player::play)
         .def("start", &Player::start)
         .def("seek", &Player::seek)
+        .def("rewind", &Player::rewind)
+        .def("goLive", &Player::goLive)
+        .def("timeshiftDelay", &Player::timeshiftDelay)
+        .def("timeshiftAvailable", &Player::timeshiftAvailable)
         .def("width", &Player::width)
         .def("height", &Player::height)
         .def("isPaused", &Player::isPaused)
         .def("isRecording", &Player::isRecording)
         .def("isMuted", &Player::isMuted)
+        .def("isTimeshifting", &Player::isTimeshifting)
+        .def("isMainStream", &Player::isMainStream)
+        .def("setMainStream", &Player::setMainStream)
         .def("isCameraStream", &Player::isCameraStream)
         .def("setVolume", &Player::setVolume)
         .def("getVolume", &Player::getVolume)
+        .def("getAudioLevel", &Player::getAudioLevel)
+        .def("getActivity", &Player::getActivity)
+        .def("getMotion", &Player::getMotion)
+        .def("getHealth", &Player::getHealth)
+        .def("droppedFrames", &Player::droppedFrames)
+        .def("getLatency", &Player::getLatency)
+        .def("latencyCatchUps", &Player::latencyCatchUps)
         .def("setMute", &Player::setMute)
         .def("hasAudio", &Player::hasAudio)
         .def("hasVideo", &Player::hasVideo)
@@ -54,21 +74,43 @@ PYBIND11_MODULE(avio, m)
         .def("togglePaused", &Player::togglePaused)
         .def("toggleRecording", &Player::toggleRecording)
         .def("startFileBreak", &Player::startFileBreak)
+        .def("addOutput", &Player::addOutput)
+        .def("removeOutput", &Player::removeOutput)
+        .def("startOutput", &Player::startOutput)
+        .def("stopOutput", &Player::stopOutput)
+        .def("isOutputRecording", &Player::isOutputRecording)
+        .def("getHlsUrl", &Player::getHlsUrl)
+        .def("getRestreamUrl", &Player::getRestreamUrl)
+        .def("restreamClients", &Player::restreamClients)
+        .def("restreamDrops", &Player::restreamDrops)
+        .def("addRendition", &Player::addRendition)
+        .def("startRendition", &Player::startRendition)
+        .def("stopRendition", &Player::stopRendition)
+        .def("isRenditionRecording", &Player::isRenditionRecording)
         .def("getAudioCodec", &Player::getAudioCodec)
         .def("clearBuffer", &Player::clearBuffer)
         .def("getStreamInfo", &Player::getStreamInfo)
+        .def("getIOStats", &Player::getIOStats)
         .def("getFFMPEGVersions", &Player::getFFMPEGVersions)
         .def("getAudioDrivers", &Player::getAudioDrivers)
         .def("getHardwareDecoders", &Player::getHardwareDecoders)
         .def("duration", &Player::duration)
         .def("terminate", &Player::terminate)
         .def_readwrite("uri", &Player::uri)
+        .def_readwrite("main_uri", &Player::main_uri)
         .def_readwrite("request_reconnect", &Player::request_reconnect)
         .def_readwrite("live_stream", &Player::live_stream)
         .def_readwrite("headless", &Player::headless)
         .def_readwrite("disable_video", &Player::disable_video)
         .def_readwrite("disable_audio", &Player::disable_audio)
         .def_readwrite("hidden", &Player::hidden)
+        .def_readwrite("async_io", &Player::async_io)
+        .def_readwrite("fragmented", &Player::fragmented)
+        .def_readwrite("segment_duration_in_seconds", &Player::segment_duration_in_seconds)
+        .def_readwrite("catalog_path", &Player::catalog_path)
+        .def_readwrite("timeshift_seconds", &Player::timeshift_seconds)
+        .def_readwrite("timeshift_ram_seconds", &Player::timeshift_ram_seconds)
+        .def_readwrite("timeshift_dir", &Player::timeshift_dir)
         .def_readwrite("progressCallback", &Player::progressCallback)
         .def_readwrite("renderCallback", &Player::renderCallback)
         .def_readwrite("pyAudioCallback", &Player::pyAudioCallback)
@@ -80,6 +122,55 @@ PYBIND11_MODULE(avio, m)
         .def_readwrite("str_video_filter", &Player::str_video_filter)
         .def_readwrite("str_audio_filter", &Player::str_audio_filter)
         .def_readwrite("audio_driver_index", &Player::audio_driver_index)
+        .def_readwrite("mix_audio", &Player::mix_audio)
+        .def_readwrite("headless_audio", &Player::headless_audio)
+        .def_readwrite("audio_level_window_ms", &Player::audio_level_window_ms)
+        .def_readwrite("silence_threshold_db", &Player::silence_threshold_db)
+        .def_readwrite("silence_min_ms", &Player::silence_min_ms)
+        .def_readwrite("audio_loudness", &Player::audio_loudness)
+        .def_readwrite("audioLevelCallback", &Player::audioLevelCallback)
+        .def_readwrite("str_sync_master", &Player::str_sync_master)
+        .def_readwrite("late_frame_threshold_ms", &Player::late_frame_threshold_ms)
+        .def_readwrite("drop_late_live", &Player::drop_late_live)
+        .def_readwrite("latency_target_ms", &Player::latency_target_ms)
+        .def_readwrite("transcode", &Player::transcode)
+        .def_readwrite("video_encoder_name", &Player::video_encoder_name)
+        .def_readwrite("audio_encoder_name", &Player::audio_encoder_name)
+        .def_readwrite("encoder_preset", &Player::encoder_preset)
+        .def_readwrite("encoder_crf", &Player::encoder_crf)
+        .def_readwrite("video_bit_rate", &Player::video_bit_rate)
+        .def_readwrite("audio_bit_rate", &Player::audio_bit_rate)
+        .def_readwrite("encoder_threads", &Player::encoder_threads)
+        .def_readwrite("hls", &Player::hls)
+        .def_readwrite("hls_directory", &Player::hls_directory)
+        .def_readwrite("hls_low_latency", &Player::hls_low_latency)
+        .def_readwrite("hls_segment_seconds", &Player::hls_segment_seconds)
+        .def_readwrite("hls_part_seconds", &Player::hls_part_seconds)
+        .def_readwrite("hls_list_size", &Player::hls_list_size)
+        .def_readwrite("hls_http_port", &Player::hls_http_port)
+        .def_readwrite("restream_port", &Player::restream_port)
+        .def_readwrite("restream_address", &Player::restream_address)
+        .def_readwrite("restream_queue_size", &Player::restream_queue_size)
+        .def_readwrite("activity_detection", &Player::activity_detection)
+        .def_readwrite("activity_threshold", &Player::activity_threshold)
+        .def_readwrite("activity_hold_ms", &Player::activity_hold_ms)
+        .def_readwrite("activity_motion_vectors", &Player::activity_motion_vectors)
+        .def_readwrite("activity_record", &Player::activity_record)
+        .def_readwrite("activity_filename", &Player::activity_filename)
+        .def_readwrite("activityCallback", &Player::activityCallback)
+        .def_readwrite("motion_detection", &Player::motion_detection)
+        .def_readwrite("motion_interval_ms", &Player::motion_interval_ms)
+        .def_readwrite("motion_width", &Player::motion_width)
+        .def_readwrite("motion_threshold", &Player::motion_threshold)
+        .def_readwrite("motion_cell_threshold", &Player::motion_cell_threshold)
+        .def_readwrite("motionCallback", &Player::motionCallback)
+        .def_readwrite("health_monitoring", &Player::health_monitoring)
+        .def_readwrite("health_interval_ms", &Player::health_interval_ms)
+        .def_readwrite("black_min_ms", &Player::black_min_ms)
+        .def_readwrite("freeze_min_ms", &Player::freeze_min_ms)
+        .def_readwrite("freeze_threshold", &Player::freeze_threshold)
+        .def_readwrite("scene_threshold", &Player::scene_threshold)
+        .def_readwrite("healthCallback", &Player::healthCallback)
         .def_readwrite("str_hw_device_type", &Player::str_hw_device_type)
         .def_readwrite("onvif_frame_rate", &Player::onvif_frame_rate)
         .def_readwrite("buffer_size_in_seconds", &Player::buffer_size_in_seconds)
@@ -111,6 +202,140 @@ PYBIND11_MODULE(avio, m)
         .def("audio_bit_rate", &Reader::audio_bit_rate)
         .def("audio_time_base", &Reader::audio_time_base);
 
+    py::class_<Catalog>(m, "Catalog")
+        .def(py::init<const std::string&>())
+        .def("lookup", &Catalog::lookup)
+        .def_readonly("path", &Catalog::path);
+
+    py::class_<CatalogHit>(m, "CatalogHit")
+        .def_readonly("filename", &CatalogHit::filename)
+        .def_readonly("uri", &CatalogHit::uri)
+        .def_readonly("start", &CatalogHit::start)
+        .def_readonly("end", &CatalogHit::end)
+        .def_readonly("key_frame_time", &CatalogHit::key_frame_time)
+        .def_readonly("media_time", &CatalogHit::media_time)
+        .def_readonly("offset", &CatalogHit::offset)
+        .def_readonly("complete", &CatalogHit::complete);
+
+    py::class_<AudioLevel>(m, "AudioLevel")
+        .def_readonly("time", &AudioLevel::time)
+        .def_readonly("duration", &AudioLevel::duration)
+        .def_readonly("rms", &AudioLevel::rms)
+        .def_readonly("peak", &AudioLevel::peak)
+        .def_readonly("loudness", &AudioLevel::loudness)
+        .def_readonly("silent", &AudioLevel::silent)
+        .def_readonly("silence", &AudioLevel::silence);
+
+    py::class_<Activity>(m, "Activity")
+        .def_readonly("time", &Activity::time)
+        .def_readonly("score", &Activity::score)
+        .def_readonly("bitrate", &Activity::bitrate)
+        .def_readonly("baseline", &Activity::baseline)
+        .def_readonly("motion", &Activity::motion)
+        .def_readonly("active", &Activity::active);
+
+    py::class_<MotionRegion>(m, "MotionRegion")
+        .def_readonly("x", &MotionRegion::x)
+        .def_readonly("y", &MotionRegion::y)
+        .def_readonly("w", &MotionRegion::w)
+        .def_readonly("h", &MotionRegion::h)
+        .def_readonly("level", &MotionRegion::level);
+
+    py::class_<Motion>(m, "Motion")
+        .def_readonly("time", &Motion::time)
+        .def_readonly("level", &Motion::level)
+        .def_readonly("motion", &Motion::motion)
+        .def_readonly("regions", &Motion::regions);
+
+    py::class_<HealthEvent>(m, "HealthEvent")
+        .def_readonly("time", &HealthEvent::time)
+        .def_readonly("type", &HealthEvent::type)
+        .def_readonly("start", &HealthEvent::start)
+        .def_readonly("value", &HealthEvent::value)
+        .def_readonly("duration", &HealthEvent::duration);
+
+    py::class_<Health>(m, "Health")
+        .def_readonly("time", &Health::time)
+        .def_readonly("mean", &Health::mean)
+        .def_readonly("dark", &Health::dark)
+        .def_readonly("difference", &Health::difference)
+        .def_readonly("scene", &Health::scene)
+        .def_readonly("black", &Health::black)
+        .def_readonly("frozen", &Health::frozen)
+        .def_readonly("scene_changes", &Health::scene_changes);
+
+    py::class_<Exporter>(m, "Exporter")
+        .def(py::init<const std::string&, const std::string&, int64_t, int64_t>())
+        .def("run", &Exporter::run, py::call_guard<py::gil_scoped_release>())
+        .def("start", &Exporter::start)
+        .def("cancel", &Exporter::cancel)
+        .def("isRunning", &Exporter::isRunning)
+        .def_readwrite("async_io", &Exporter::async_io)
+        .def_readwrite("disable_video", &Exporter::disable_video)
+        .def_readwrite("disable_audio", &Exporter::disable_audio)
+        .def_readwrite("progressCallback", &Exporter::progressCallback)
+        .def_readwrite("exportFinished", &Exporter::exportFinished)
+        .def_readwrite("errorCallback", &Exporter::errorCallback);
+
+    py::class_<FrameReader>(m, "FrameReader")
+        .def(py::init<const std::string&, const std::string&, const std::string&>(),
+                py::arg("uri"), py::arg("filter") = "format=rgb24", py::arg("hw_device_type") = "")
+        .def("__iter__", [](FrameReader& r) -> FrameReader& { return r; })
+        .def("__next__", [](FrameReader& r) {
+            Frame f;
+            {
+                py::gil_scoped_release release;
+                f = r.next();
+            }
+            if (f.is_null())
+                throw py::stop_iteration();
+            return f;
+        })
+        .def("time", &FrameReader::time)
+        .def("width", &FrameReader::width)
+        .def("height", &FrameReader::height)
+        .def("fps", &FrameReader::fps)
+        .def("duration", &FrameReader::duration)
+        .def_readonly("count", &FrameReader::count);
+
+    py::class_<FrameExtractor>(m, "FrameExtractor")
+        .def(py::init<const std::string&, const std::string&, const std::string&>(),
+                py::arg("uri"), py::arg("filter") = "format=rgb24", py::arg("hw_device_type") = "")
+        .def("extract", [](FrameExtractor& e, const std::vector<int64_t>& times) {
+            std::vector<Frame> frames;
+            {
+                py::gil_scoped_release release;
+                frames = e.extract(times);
+            }
+            // times with no frame come back as None
+            std::vector<std::optional<Frame>> result;
+            for (Frame& f : frames) {
+                if (f.is_null())
+                    result.emplace_back(std::nullopt);
+                else
+                    result.emplace_back(std::move(f));
+            }
+            return result;
+        })
+        .def_readwrite("max_forward", &FrameExtractor::max_forward)
+        .def_readonly("seeks", &FrameExtractor::seeks)
+        .def_readonly("decoded", &FrameExtractor::decoded);
+
+    py::class_<BatchDecoder>(m, "BatchDecoder")
+        .def(py::init<const std::vector<std::string>&, const std::string&, int>(),
+                py::arg("uris"), py::arg("filter") = "format=rgb24", py::arg("workers") = 0)
+        .def("run", &BatchDecoder::run, py::call_guard<py::gil_scoped_release>())
+        .def("start", &BatchDecoder::start)
+        .def("cancel", &BatchDecoder::cancel)
+        .def_readwrite("hw_device_type", &BatchDecoder::hw_device_type)
+        .def_readwrite("gop_parallel", &BatchDecoder::gop_parallel)
+        .def_readwrite("chunk_seconds", &BatchDecoder::chunk_seconds)
+        .def_readwrite("max_buffered", &BatchDecoder::max_buffered)
+        .def_readwrite("frameCallback", &BatchDecoder::frameCallback)
+        .def_readwrite("fileFinished", &BatchDecoder::fileFinished)
+        .def_readwrite("errorCallback", &BatchDecoder::errorCallback)
+        .def_readonly("running", &BatchDecoder::running);
+
     py::class_<Frame>(m, "Frame", py::buffer_protocol())
         .def(py::init<>())
         .def(py::init<const Frame&>())
@@ -150,4 +375,4 @@ PYBIND11_MODULE(avio, m)
 
 }
 
-}
\ No newline at end of file
+}
\ No newline at end of file